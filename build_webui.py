@@ -4,6 +4,8 @@ import sys
 import os
 import platform
 import subprocess
+import hashlib
+import struct
 
 Import("env")
 
@@ -27,4 +29,76 @@ def build_web():
         finally:
             os.chdir("..");
 
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".ico": "image/x-icon",
+}
+
+def write_bundle():
+    # packs webui/dist into webui.bin, which is served from the spiffs partition (see webuibundle.h)
+    dist = os.path.join("webui", "dist")
+    if not os.path.isdir(dist):
+        return
+
+    files = []
+    for name in sorted(os.listdir(dist)):
+        if not name.endswith(".gz"):
+            continue
+        path = "/" + name[:-3]
+        with open(os.path.join(dist, name), "rb") as fp:
+            content = fp.read()
+        flags = 0x01  # gzip
+        if path != "/index.html":
+            flags |= 0x02  # immutable, file names contain the content hash
+        files.append((path, CONTENT_TYPES[os.path.splitext(path)[1]], flags, content))
+
+    header_size = 44
+    entry_size = 64
+    offset = header_size + len(files) * entry_size
+
+    entries = b""
+    data = b""
+    for path, content_type, flags, content in files:
+        entries += struct.pack("<32s23sBII", path.encode(), content_type.encode(), flags, offset + len(data), len(content))
+        data += content
+
+    body = entries + data
+    header = struct.pack("<IHHI32s", 0x49554248, 1, len(files), header_size + len(body), hashlib.sha256(body).digest())
+
+    with open(os.path.join(dist, "webui.bin"), "wb") as fp:
+        fp.write(header + body)
+
+def spiffs_offset():
+    # offset of the spiffs partition, the empty offsets in partitions.csv are filled like gen_esp32part.py does
+    offset = 0x9000
+    with open(env.subst("$PARTITIONS_TABLE_CSV") or "partitions.csv") as fp:
+        for line in fp:
+            line = line.split("#")[0].strip()
+            if not line:
+                continue
+            name, kind, subtype, part_offset, size = [field.strip() for field in line.split(",")[:5]]
+            align = 0x10000 if kind == "app" else 0x1000
+            offset = int(part_offset, 0) if part_offset else (offset + align - 1) & ~(align - 1)
+            if subtype == "spiffs":
+                return offset
+            offset += int(size, 0)
+    sys.stderr.write("No spiffs partition found\n")
+    env.Exit(1)
+
+def upload_webui(source, target, env):
+    env.AutodetectUploadPort()
+    env.Execute('"$PYTHONEXE" "$UPLOADER" --chip esp32 --port "$UPLOAD_PORT" --baud $UPLOAD_SPEED write_flash 0x%x "%s"' % (spiffs_offset(), os.path.join("webui", "dist", "webui.bin")))
+
 build_web()
+write_bundle()
+
+# pio run -t uploadwebui writes the web UI bundle via USB, e.g. after flashing a new board or when updating
+# from a firmware which still contained the web UI
+env.AddCustomTarget(
+    name="uploadwebui",
+    dependencies=None,
+    actions=upload_webui,
+    title="Upload web UI",
+    description="Write webui/dist/webui.bin to the spiffs partition")
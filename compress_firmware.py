@@ -0,0 +1,25 @@
+import gzip
+import os
+
+Import("env")
+
+def compress_firmware(source, target, env):
+    # firmware_x_y_z.bin.gz can be uploaded instead of the plain image and is decompressed on the device
+    firmware = target[0].get_abspath()
+    with open(firmware, "rb") as fp:
+        content = fp.read()
+
+    with gzip.open(firmware + ".gz", "wb", compresslevel=9) as fp:
+        fp.write(content)
+
+    print("Compressed %s from %d to %d bytes" % (os.path.basename(firmware), len(content), os.path.getsize(firmware + ".gz")))
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", compress_firmware)
+
+# OTA_DELTA_BASE=<image of the installed version> pio run -t ota_delta creates and verifies a delta update
+env.AddCustomTarget(
+    name="ota_delta",
+    dependencies="$BUILD_DIR/${PROGNAME}.bin",
+    actions='"$PYTHONEXE" ota_delta.py create "%s" "$BUILD_DIR/${PROGNAME}.bin" "$BUILD_DIR/${PROGNAME}.delta.gz"' % os.environ.get("OTA_DELTA_BASE", ""),
+    title="OTA delta",
+    description="Create a delta update against OTA_DELTA_BASE")
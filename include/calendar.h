@@ -0,0 +1,124 @@
+/* 
+ *  calendar.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Constant time conversions between proleptic Gregorian dates and days since 1970-01-01,
+// based on the algorithms by Howard Hinnant. Written as C++11 constexpr one-liners.
+
+constexpr uint8_t bcd2bin(uint8_t val)
+{
+    return val - 6 * (val >> 4);
+}
+
+constexpr uint8_t bin2bcd(uint8_t val)
+{
+    return val + 6 * (val / 10);
+}
+
+constexpr bool isLeapYear(int year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+constexpr int32_t _calendarEra(int32_t year)
+{
+    return (year >= 0 ? year : year - 399) / 400;
+}
+
+constexpr uint32_t _calendarDayOfEra(uint32_t yearOfEra, uint32_t dayOfYear)
+{
+    return yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+}
+
+constexpr int32_t _daysFromCivil(int32_t year, unsigned month, unsigned day)
+{
+    // year starts at March 1st, so the leap day is the last day of the year
+    return _calendarEra(year) * 146097 + (int32_t)_calendarDayOfEra(year - _calendarEra(year) * 400, (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1) - 719468;
+}
+
+constexpr int32_t daysFromCivil(int32_t year, unsigned month, unsigned day)
+{
+    return _daysFromCivil(month <= 2 ? year - 1 : year, month, day);
+}
+
+constexpr int64_t epochFromCivil(int32_t year, unsigned month, unsigned day, int hour, int minute, int second)
+{
+    return (int64_t)daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+constexpr int32_t _calendarShiftedEra(int32_t days)
+{
+    return (days >= 0 ? days : days - 146096) / 146097;
+}
+
+constexpr uint32_t _calendarDayOfShiftedEra(int32_t days)
+{
+    return (uint32_t)(days - _calendarShiftedEra(days) * 146097);
+}
+
+constexpr uint32_t _calendarYearOfEra(uint32_t dayOfEra)
+{
+    return (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+}
+
+constexpr uint32_t _calendarDayOfYear(uint32_t dayOfEra)
+{
+    return dayOfEra - _calendarDayOfEra(_calendarYearOfEra(dayOfEra), 0);
+}
+
+constexpr uint32_t _calendarShiftedMonth(uint32_t dayOfEra)
+{
+    return (5 * _calendarDayOfYear(dayOfEra) + 2) / 153;
+}
+
+constexpr unsigned monthFromDays(int32_t days)
+{
+    return _calendarShiftedMonth(_calendarDayOfShiftedEra(days + 719468)) < 10 ? _calendarShiftedMonth(_calendarDayOfShiftedEra(days + 719468)) + 3 : _calendarShiftedMonth(_calendarDayOfShiftedEra(days + 719468)) - 9;
+}
+
+constexpr unsigned dayFromDays(int32_t days)
+{
+    return _calendarDayOfYear(_calendarDayOfShiftedEra(days + 719468)) - (153 * _calendarShiftedMonth(_calendarDayOfShiftedEra(days + 719468)) + 2) / 5 + 1;
+}
+
+constexpr int32_t yearFromDays(int32_t days)
+{
+    return (int32_t)_calendarYearOfEra(_calendarDayOfShiftedEra(days + 719468)) + _calendarShiftedEra(days + 719468) * 400 + (monthFromDays(days) <= 2 ? 1 : 0);
+}
+
+// 0 = Sunday
+constexpr unsigned weekdayFromDays(int32_t days)
+{
+    return (unsigned)(days >= -4 ? (days + 4) % 7 : (days + 5) % 7 + 6);
+}
+
+inline void civilFromDays(int32_t days, int *year, int *month, int *day)
+{
+    *year = yearFromDays(days);
+    *month = monthFromDays(days);
+    *day = dayFromDays(days);
+}
+
+static_assert(daysFromCivil(1970, 1, 1) == 0, "calendar epoch");
+static_assert(daysFromCivil(2000, 3, 1) == 11017, "calendar leap day");
+static_assert(yearFromDays(10957) == 2000 && monthFromDays(10957) == 1 && dayFromDays(10957) == 1, "calendar inverse");
+static_assert(weekdayFromDays(0) == 4, "calendar weekday");
@@ -17,6 +17,8 @@
  *  
  */
 
+#pragma once
+
 #include "systemclock.h"
 #include "settings.h"
 
@@ -27,4 +29,11 @@ public:
 
     void start(void);
     void stop(void);
+
+    uint32_t getInterruptsPerMinute();
+    uint32_t getCpuTimePerMinute();
+
+    bool isCalibrating();
+    int getCalibrationSampleCount();
+    int32_t getCalibrationDeviation();
 };
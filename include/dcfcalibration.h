@@ -0,0 +1,47 @@
+/* 
+ *  dcfcalibration.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define DCF_CALIBRATION_SAMPLES 180
+
+// Estimates the receiver delay of DCF second marks from samples against a reference clock.
+// Uses median and MAD, so single outliers (e.g. a clock step) do not disturb the result.
+class DcfCalibration
+{
+private:
+    int32_t _samples[DCF_CALIBRATION_SAMPLES];
+    int _sampleCount;
+    int32_t _offset;
+    int32_t _deviation;
+    int32_t _confidence;
+
+public:
+    DcfCalibration();
+
+    void reset();
+    bool addSample(int32_t delay);
+
+    int getSampleCount();
+    int32_t getOffset();
+    int32_t getDeviation();
+    int32_t getConfidence();
+};
@@ -0,0 +1,81 @@
+/* 
+ *  dcfdecoder.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define DCF_HISTORY_LENGTH 8
+
+typedef struct
+{
+    int year; // 4 digits
+    int month;
+    int day;
+    int hour;
+    int minute;
+    int second;       // second of the pulse which completed the minute
+    uint8_t timezone; // 1: CEST, 2: CET
+} dcf_time_t;
+
+typedef enum
+{
+    DCF_FIELD_MINUTE,
+    DCF_FIELD_HOUR,
+    DCF_FIELD_DATE
+} dcf_field_t;
+
+typedef struct
+{
+    int8_t bits[60]; // -100 (surely 0) .. 100 (surely 1), 0 if unknown
+    uint32_t minuteIndex;
+} dcf_frame_t;
+
+// Soft-decision DCF77 decoder, keeps the confidence of every bit and votes over consecutive minutes.
+// Does not depend on ESP-IDF, all timestamps (usec, monotonic) are passed in by the caller.
+class DcfDecoder
+{
+private:
+    dcf_frame_t _history[DCF_HISTORY_LENGTH];
+    uint8_t _historyCount;
+
+    int8_t _slots[60];     // soft bits of the last 60 seconds, indexed by slot % 60
+    uint8_t _gapScore[60]; // evidence for the missing pulse of the minute mark
+    int64_t _lastPulse;
+    int64_t _lastSlot;
+    int _phase; // slot % 60 of the minute mark, -1 if unknown
+    uint8_t _rejectedPulses;
+    int64_t _lastDecodedMinute; // UTC minutes since 1970 of the last decoded frame
+    uint32_t _lastDecodedIndex;
+
+    void _updatePhase(int64_t slot);
+    void _addFrame(int64_t slot);
+    bool _decode(dcf_time_t *time, int minMargin);
+    bool _confirm(const dcf_time_t *time);
+    bool _isClean(const dcf_time_t *time);
+    int _score(dcf_field_t field, int value, int startBit, int bits, int parityBit, int minute, int hour);
+    bool _bestValue(dcf_field_t field, int first, int last, int startBit, int bits, int parityBit, int minute, int hour, int minMargin, int *value);
+
+public:
+    DcfDecoder();
+
+    void reset();
+    bool isLocked();
+    bool addPulse(int64_t secondMark, int64_t pulseLength, dcf_time_t *time);
+};
@@ -0,0 +1,94 @@
+/* 
+ *  deltadecoder.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#define DELTA_MAGIC 0x4c444248 // "HBDL"
+#define DELTA_VERSION 1
+#define DELTA_SOURCE_BUFFER_SIZE 4096
+
+// Delta format, written by ota_delta.py. All values are little endian.
+// A DIFF op adds its bytes to the source at the given offset, an INSERT op contains new bytes.
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t sourceLength;
+    uint8_t sourceSha256[32];
+    uint32_t targetLength;
+} __attribute__((packed)) delta_header_t;
+
+typedef enum
+{
+    DELTA_OP_END = 0,
+    DELTA_OP_DIFF = 1,   // uint32 source offset, uint32 length, length diff bytes
+    DELTA_OP_INSERT = 2, // uint32 length, length bytes
+} delta_op_t;
+
+typedef esp_err_t (*delta_output_func_t)(void *context, const char *data, size_t length);
+
+// Streaming patcher that rebuilds an image from the running partition and a delta.
+// RAM usage is bounded by the source buffer, independent of the image size.
+class DeltaDecoder
+{
+private:
+    typedef enum
+    {
+        STATE_HEADER,
+        STATE_OP,
+        STATE_DIFF,
+        STATE_INSERT,
+        STATE_DONE,
+    } state_t;
+
+    const esp_partition_t *_source;
+    delta_output_func_t _output;
+    void *_context;
+    uint8_t *_sourceBuffer;
+
+    state_t _state;
+    delta_header_t _header;
+    uint8_t _field[9];
+    size_t _fieldLength;
+    uint32_t _sourceOffset;
+    uint32_t _remaining;
+    uint32_t _outputLength;
+
+    esp_err_t _verifySource();
+    esp_err_t _parseOp();
+    esp_err_t _writeDiff(const uint8_t *data, size_t length);
+
+public:
+    static bool isDelta(const char *data, size_t length);
+
+    DeltaDecoder(const esp_partition_t *source, delta_output_func_t output, void *context);
+    ~DeltaDecoder();
+
+    esp_err_t begin();
+    esp_err_t write(const char *data, size_t length);
+    esp_err_t end();
+
+    uint32_t getOutputLength();
+};
@@ -46,11 +46,15 @@ private:
   Settings *_settings;
   bool _isConnected;
 
+  void _applyIPSettings();
+
 public:
   Ethernet(Settings *settings);
 
   void start();
   void stop();
+  void reconfigure();
+  bool isConnected();
 
   void getNetworkSettings(ip4_addr_t *ip, ip4_addr_t *netmask, ip4_addr_t *gateway, ip4_addr_t *dns1, ip4_addr_t *dns2);
 
@@ -0,0 +1,86 @@
+/* 
+ *  eventlog.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define EVENTLOG_CAPACITY 256      // records, 24 bytes each
+#define EVENTLOG_MAX_SITES 32      // distinct call sites
+#define EVENTLOG_MAX_ARGS 4
+#define EVENTLOG_RATE_LIMIT 5      // records per call site and second, further ones are only counted
+
+typedef struct
+{
+    const char *tag;
+    const char *format; // integer conversions only, the arguments are stored as uint32_t
+    esp_log_level_t level;
+    int16_t index;      // -1 until the first record
+    uint16_t count;     // records in the current window
+    uint16_t suppressed; // records dropped by the rate limit since the last stored one
+    uint32_t windowStart;
+} eventlog_site_t;
+
+typedef struct
+{
+    uint32_t timestamp; // msec since boot
+    uint16_t site;
+    uint16_t suppressed;
+    uint32_t args[EVENTLOG_MAX_ARGS];
+} eventlog_record_t;
+
+// deferred replacement for ESP_LOGx: stores a binary record and returns, a background task prints it
+#define EVENTLOG(level, tag, format, ...)                                         \
+    do                                                                            \
+    {                                                                             \
+        static eventlog_site_t _eventlogSite = {tag, format, level, -1, 0, 0, 0}; \
+        eventlog_write(&_eventlogSite, ##__VA_ARGS__);                            \
+    } while (0)
+
+#define EVENTLOG_E(tag, format, ...) EVENTLOG(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define EVENTLOG_W(tag, format, ...) EVENTLOG(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define EVENTLOG_I(tag, format, ...) EVENTLOG(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+
+class EventLog
+{
+public:
+    static void start();
+    static void stop();
+
+    static void log(eventlog_site_t *site, const uint32_t *args, size_t argc);
+
+    // sequence numbers of the oldest and the next record, a record is valid while seq is in [first, next)
+    static uint32_t getFirstSeq();
+    static uint32_t getNextSeq();
+    static bool read(uint32_t seq, eventlog_record_t *record);
+    static int format(const eventlog_record_t *record, char *buffer, size_t len);
+
+    static uint32_t getDroppedCount();
+};
+
+template <typename... Args>
+inline void eventlog_write(eventlog_site_t *site, Args... args)
+{
+    const uint32_t values[] = {0, (uint32_t)args...};
+    EventLog::log(site, values + 1, sizeof...(Args));
+}
@@ -17,6 +17,8 @@
  *  
  */
 
+#pragma once
+
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
@@ -24,6 +26,7 @@
 #include "systemclock.h"
 #include "settings.h"
 #include "linereader.h"
+#include "ppspairing.h"
 
 class GPS
 {
@@ -33,7 +36,17 @@ private:
     TaskHandle_t _tHandle = NULL;
     QueueHandle_t _uart_queue;
     LineReader *_lineReader;
+    uint8_t *_buffer = NULL;
     uint64_t _nextSync = 0;
+    bool _hasFix = false;
+    gpio_num_t _ppsPin = GPIO_NUM_NC;
+    QueueHandle_t _pps_queue = NULL;
+    PpsPairing _ppsPairing;
+    uint32_t _wakeups = 0;
+    uint32_t _wakeupsPerSecond = 0;
+    int64_t _wakeupWindowStart = 0;
+
+    void _countWakeup();
 
 public:
     GPS(Settings *settings, SystemClock *clk);
@@ -41,6 +54,8 @@ public:
     void start(void);
     void stop(void);
 
+    uint32_t getWakeupsPerSecond();
+
     void _gpsSerialQueueHandler();
     void _handleLine(unsigned char *buffer, uint16_t len);
 };
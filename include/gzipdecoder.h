@@ -0,0 +1,61 @@
+/* 
+ *  gzipdecoder.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// deflate allows back references up to 32 kB, so this is the largest window any gzip stream needs
+#define GZIP_WINDOW_SIZE 32768
+
+typedef esp_err_t (*gzip_output_func_t)(void *context, const char *data, size_t length);
+
+// Streaming gzip decoder based on the miniz inflater in ROM. The window and the
+// inflater state are allocated in internal RAM for the lifetime of the decoder.
+class GzipDecoder
+{
+private:
+    void *_inflator;
+    uint8_t *_window;
+    size_t _windowOffset;
+    bool _headerParsed;
+    bool _finished;
+    uint8_t _trailer[8];
+    size_t _trailerLength;
+    uint32_t _outputLength;
+    uint32_t _crc; // running CRC32 of the output, checked against the trailer
+    gzip_output_func_t _output;
+    void *_context;
+
+    esp_err_t _parseHeader(const uint8_t **data, size_t *length);
+
+public:
+    static bool isGzip(const char *data, size_t length);
+
+    GzipDecoder(gzip_output_func_t output, void *context);
+    ~GzipDecoder();
+
+    esp_err_t begin();
+    esp_err_t write(const char *data, size_t length);
+    esp_err_t end();
+
+    uint32_t getOutputLength();
+};
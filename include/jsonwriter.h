@@ -0,0 +1,70 @@
+/* 
+ *  jsonwriter.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_http_server.h"
+
+#define CHUNKED_WRITER_BUFFER_SIZE 1024
+#define JSON_WRITER_MAX_DEPTH 16
+
+// Buffers response data and sends it as HTTP chunks, so no complete document is ever held in memory.
+class ChunkedWriter
+{
+private:
+    httpd_req_t *_req;
+    char _buffer[CHUNKED_WRITER_BUFFER_SIZE];
+    size_t _length;
+    esp_err_t _result;
+
+public:
+    ChunkedWriter(httpd_req_t *req);
+
+    void write(const char *data, size_t length);
+    void write(const char *data);
+    void printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void flush();
+    esp_err_t end();
+};
+
+// Emits compact JSON into a chunked response. Pass name = NULL for array elements.
+class JsonWriter : public ChunkedWriter
+{
+private:
+    uint32_t _hasItems;
+    uint8_t _depth;
+
+    void _beginItem(const char *name);
+    void _writeString(const char *value);
+
+public:
+    JsonWriter(httpd_req_t *req);
+
+    void beginObject(const char *name = NULL);
+    void endObject();
+    void beginArray(const char *name = NULL);
+    void endArray();
+
+    void addString(const char *name, const char *value);
+    void addNumber(const char *name, double value);
+    void addBool(const char *name, bool value);
+    void addNumberArray(const char *name, const float *values, int count);
+};
@@ -40,14 +40,22 @@ class LED
 {
 private:
     uint8_t _state;
+    int8_t _pinState = -1; // last value written to the LEDC, -1 if unknown
     ledc_channel_config_t _channel_conf;
     void _setPinState(bool enabled);
 
 public:
     static void start(Settings *settings);
     static void stop();
+    static void setBrightness(int brightness);
+
+    static uint32_t getAvoidedWakeups();
+    static uint32_t getAvoidedRegisterWrites();
 
     LED(gpio_num_t pin);
     void setState(led_state_t state);
-    void updatePinState();
+
+    bool _isBlinking();
+    bool _getPatternState(uint32_t tick);
+    void _updatePinState(uint32_t tick);
 };
\ No newline at end of file
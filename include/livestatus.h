@@ -0,0 +1,82 @@
+/* 
+ *  livestatus.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_http_server.h"
+#include "settings.h"
+#include "sysinfo.h"
+#include "rawuartudplistener.h"
+#include "systemclock.h"
+
+#define LIVE_STATUS_MAX_SUBSCRIBERS 4
+#define LIVE_STATUS_MIN_INTERVAL 250 // msec
+#define LIVE_STATUS_MAX_MESSAGE 256
+
+typedef struct
+{
+    int cpuUsage;          // 0.1 percent
+    int memoryUsage;       // 0.1 percent
+    uint32_t rawUartRemoteAddress;
+    int framesToRemote;    // 0.1 frames per second
+    int framesFromRemote;  // 0.1 frames per second
+    int clockSource;
+    int64_t lastSyncTime;  // sec since epoch
+} live_status_t;
+
+class LiveStatus
+{
+private:
+    Settings *_settings;
+    SysInfo *_sysInfo;
+    RawUartUdpListener *_rawUartUdpListener;
+    SystemClock *_clk;
+    TaskHandle_t _tHandle = NULL;
+    SemaphoreHandle_t _mutex;
+    httpd_handle_t _server = NULL;
+    int _subscribers[LIVE_STATUS_MAX_SUBSCRIBERS];
+    uint8_t _subscriberCount = 0;
+    live_status_t _status;
+    bool _hasStatus = false;
+    uint32_t _lastFramesToRemote = 0;
+    uint32_t _lastFramesFromRemote = 0;
+    int64_t _lastSample = 0;
+
+    void _sample(live_status_t *status);
+
+public:
+    LiveStatus(Settings *settings, SysInfo *sysInfo, RawUartUdpListener *rawUartUdpListener, SystemClock *clk);
+
+    void start();
+    void stop();
+
+    esp_err_t subscribe(httpd_req_t *req);
+    uint8_t getSubscriberCount();
+
+    // writes the fields of status differing from previous as a JSON object, all fields if previous is NULL
+    static int formatDelta(const live_status_t *status, const live_status_t *previous, char *buffer, size_t len);
+
+    void _samplerTask();
+    void _broadcast(char *message);
+};
@@ -0,0 +1,53 @@
+/* 
+ *  nmea.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define NMEA_MAX_FIELDS 24
+
+typedef struct
+{
+    const unsigned char *data;
+    uint16_t len;
+} nmea_field_t;
+
+// Splits a NMEA 0183 sentence into fields pointing into the original buffer, nothing is copied.
+// Does not depend on ESP-IDF, so it can be compiled on the host.
+class NmeaSentence
+{
+private:
+    nmea_field_t _fields[NMEA_MAX_FIELDS];
+    uint8_t _fieldCount = 0;
+
+public:
+    static bool hasType(const unsigned char *buffer, uint16_t len, const char *type);
+
+    bool parse(const unsigned char *buffer, uint16_t len);
+
+    bool isType(const char *type);
+    uint8_t getFieldCount();
+    nmea_field_t getField(uint8_t index);
+
+    char getChar(uint8_t index);
+    bool getInt(uint8_t index, int *value);
+    bool getTime(uint8_t index, int *hour, int *minute, int *second, int *usec);
+    bool getDate(uint8_t index, int *day, int *month, int *year);
+};
@@ -48,7 +48,9 @@ class NtpServer {
     udp_pcb* _pcb;
     QueueHandle_t _udp_queue;
     TaskHandle_t _tHandle = NULL;
+    volatile uint32_t _requestCount = 0; // only written by the queue handler task
 
+    void fillSyncQuality(ntp_packet_t *ntp, struct timeval *lastSync);
     void handlePacket(pbuf *pb, ip4_addr_t addr, uint16_t port);
 
   public: 
@@ -57,6 +59,8 @@ class NtpServer {
     void start();
     void stop();
 
+    uint32_t getRequestCount();
+
     void _udpQueueHandler();
     bool _udpReceivePacket(pbuf *pb, const ip_addr_t *addr, uint16_t port);
 };
@@ -0,0 +1,86 @@
+/* 
+ *  otapipeline.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_ota_ops.h"
+#include "mbedtls/md.h"
+#include "webuibundle.h"
+#include "gzipdecoder.h"
+#include "deltadecoder.h"
+
+#define OTA_PIPELINE_BUFFER_COUNT 2
+#define OTA_PIPELINE_BUFFER_SIZE (16 * 1024)
+
+// Writes an update to flash in a separate task while the next buffer is received.
+// Firmware images go to the next OTA partition, web UI bundles (detected by magic) to the web UI partition.
+// Gzip compressed firmware images are decompressed on the fly, deltas are applied against the running partition.
+class OtaPipeline
+{
+private:
+    WebUIBundle *_bundle;
+    char *_buffers[OTA_PIPELINE_BUFFER_COUNT];
+    size_t _lengths[OTA_PIPELINE_BUFFER_COUNT];
+    QueueHandle_t _freeQueue;
+    QueueHandle_t _filledQueue;
+    SemaphoreHandle_t _done;
+    bool _writerRunning;
+    volatile esp_err_t _result;
+
+    bool _started;
+    bool _isWebUIBundle;
+    size_t _imageSize;
+    const esp_partition_t *_partition;
+    esp_ota_handle_t _otaHandle;
+    GzipDecoder *_decoder;
+    DeltaDecoder *_delta;
+    bool _imageStarted;
+    mbedtls_md_context_t _sha;
+
+    size_t _written;
+    int64_t _startTime;
+    int64_t _endTime;
+
+    esp_err_t _write(const char *data, size_t length);
+    void _stopWriter();
+
+public:
+    OtaPipeline(WebUIBundle *bundle);
+    ~OtaPipeline();
+
+    esp_err_t begin(size_t imageSize);
+    char *getBuffer(size_t *size);
+    esp_err_t commit(char *buffer, size_t length);
+    esp_err_t end(const uint8_t *expectedSha256);
+    void abort();
+
+    bool isWebUIBundle();
+    size_t getWritten();
+    float getThroughput(); // MB/s
+
+    void _writerTask();
+    esp_err_t _writeImage(const char *data, size_t length);
+    esp_err_t _writeOta(const char *data, size_t length);
+};
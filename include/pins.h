@@ -39,6 +39,15 @@
 
 #define DCF_PIN GPIO_NUM_39
 
+// GPIO3 (RX of the programming header) is the only header pin not used by the board,
+// using it as GPS PPS input disables the console input of UART0
+#define GPS_PPS_HEADER_PIN GPIO_NUM_3
+
+inline bool isValidGpsPpsPin(int pin)
+{
+    return pin == -1 || pin == GPS_PPS_HEADER_PIN;
+}
+
 #define BOARD_REV_SENSE_CHANNEL ((adc_channel_t)ADC1_GPIO36_CHANNEL)
 #define BOARD_REV_SENSE_UNIT ADC_UNIT_1
 
@@ -0,0 +1,39 @@
+/* 
+ *  ppspairing.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Pairs NMEA second labels with pulse-per-second edges and rejects glitches.
+// Does not depend on ESP-IDF, all timestamps (usec, monotonic) are passed in by the caller.
+class PpsPairing
+{
+private:
+    int64_t _lastEdge;
+    uint32_t _validEdges;
+
+public:
+    PpsPairing();
+
+    void addEdge(int64_t edgeTime);
+    bool isLocked();
+    bool pair(int64_t sentenceTime, int64_t *edgeTime);
+    void reset();
+};
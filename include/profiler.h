@@ -0,0 +1,79 @@
+/* 
+ *  profiler.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define PROFILER_MAX_TASKS 40
+#define PROFILER_MAX_ISRS 4
+#define PROFILER_WINDOW_COUNT 3 // last second, 1 minute average, 15 minutes average
+
+typedef struct
+{
+    TaskHandle_t handle;
+    char name[configMAX_TASK_NAME_LEN];
+    int core; // -1 if not pinned
+    uint32_t priority;
+    uint32_t stackHighWaterMark; // bytes
+    uint32_t lastRunTime;
+    float load[PROFILER_WINDOW_COUNT]; // percent of one core
+} profiler_task_t;
+
+typedef struct
+{
+    const char *name;
+    volatile uint32_t *count;
+    volatile uint32_t *time; // usec
+    uint32_t lastCount;
+    uint32_t lastTime;
+    float rate[PROFILER_WINDOW_COUNT]; // per second
+    float load[PROFILER_WINDOW_COUNT]; // percent of one core
+} profiler_isr_t;
+
+class Profiler
+{
+private:
+    profiler_task_t _tasks[PROFILER_MAX_TASKS];
+    uint8_t _taskCount = 0;
+    float _coreLoad[portNUM_PROCESSORS][PROFILER_WINDOW_COUNT];
+    uint32_t _lastTotalRunTime = 0;
+    TaskStatus_t *_taskStatus = NULL;
+    SemaphoreHandle_t _mutex;
+
+    void _sampleTasks(UBaseType_t taskCount, uint32_t totalRunTime);
+    void _sampleIsrs(uint32_t elapsed);
+
+public:
+    static const char *windowNames[PROFILER_WINDOW_COUNT];
+
+    Profiler();
+    void start();
+
+    static void registerIsr(const char *name, volatile uint32_t *count, volatile uint32_t *time);
+
+    uint8_t getTasks(profiler_task_t *tasks, uint8_t maxCount);
+    uint8_t getIsrs(profiler_isr_t *isrs, uint8_t maxCount);
+    float getCoreLoad(int core, int window);
+
+    void _sample();
+};
@@ -36,6 +36,8 @@ private:
     std::atomic<bool> _connectionStarted;
     std::atomic<int> _counter;
     std::atomic<int> _endpointConnectionIdentifier;
+    std::atomic<uint32_t> _framesToRemote;
+    std::atomic<uint32_t> _framesFromRemote;
     uint64_t _lastReceivedKeepAlive;
     udp_pcb *_pcb;
     QueueHandle_t _udp_queue;
@@ -51,6 +53,8 @@ public:
     void handleEvent();
 
     ip4_addr_t getConnectedRemoteAddress();
+    uint32_t getFramesToRemote();
+    uint32_t getFramesFromRemote();
 
     void start();
     void stop();
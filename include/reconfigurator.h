@@ -0,0 +1,80 @@
+/* 
+ *  reconfigurator.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "settings.h"
+#include "ethernet.h"
+#include "mdnsserver.h"
+#include "ntpclient.h"
+#include "gps.h"
+#include "dcf.h"
+#include "remotesyslog.h"
+
+typedef enum
+{
+    RECONFIGURE_NETWORK = 0,
+    RECONFIGURE_MDNS = 1,
+    RECONFIGURE_NTP = 2,
+    RECONFIGURE_GPS = 3,
+    RECONFIGURE_DCF = 4,
+    RECONFIGURE_LED = 5,
+    RECONFIGURE_COUNT = 6,
+} reconfigure_kind_t;
+
+class Reconfigurator
+{
+private:
+    Settings *_settings;
+    Ethernet *_ethernet;
+    MDns *_mdns;
+    NtpClient *_ntpClient;
+    GPS *_gps;
+    DCF *_dcf;
+    RemoteSyslog *_syslog;
+    TaskHandle_t _tHandle = NULL;
+    QueueHandle_t _queue = NULL;
+    bool _ntpRunning;
+    bool _gpsRunning;
+    bool _dcfRunning;
+
+    void _apply(uint32_t changes);
+    void _reconfigureNetwork();
+    void _reconfigureTimesources(uint32_t changes);
+    void _recordOutage(reconfigure_kind_t kind, int64_t started);
+
+public:
+    static const char *kindNames[RECONFIGURE_COUNT];
+
+    Reconfigurator(Settings *settings, Ethernet *ethernet, MDns *mdns, NtpClient *ntpClient, GPS *gps, DCF *dcf, RemoteSyslog *syslog);
+
+    void start();
+    void stop();
+
+    // duration of the last service interruption caused by a reconfiguration in usec, -1 if never reconfigured
+    static int64_t getLastOutage(reconfigure_kind_t kind);
+
+    void _handleChanges(uint32_t changes);
+    void _reconfiguratorTask();
+};
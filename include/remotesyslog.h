@@ -0,0 +1,64 @@
+/* 
+ *  remotesyslog.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+
+#pragma once
+
+#include <stdarg.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "lwip/opt.h"
+#include "lwip/udp.h"
+#include "esp_log.h"
+#include "settings.h"
+
+#define SYSLOG_BUFFER_SIZE 4096
+#define SYSLOG_MAX_LINE 192
+#define SYSLOG_DEFAULT_PORT 514
+#define SYSLOG_RESOLVE_INTERVAL 10000000 // usec between failed lookups
+#define SYSLOG_MAX_CAPTURE_PRIORITY 10   // lines logged by tasks at or above this priority are not forwarded
+
+class RemoteSyslog
+{
+private:
+    Settings *_settings;
+    RingbufHandle_t _buffer = NULL;
+    TaskHandle_t _tHandle = NULL;
+    udp_pcb *_pcb = NULL;
+    ip_addr_t _addr;
+    uint16_t _port = SYSLOG_DEFAULT_PORT;
+    bool _resolved = false;
+    int64_t _nextResolve = 0;
+
+    bool _resolve();
+    void _send(const char *entry, size_t len);
+
+public:
+    RemoteSyslog(Settings *settings);
+
+    void start();
+    void stop();
+    void reconfigure();
+
+    static uint32_t getDroppedCount();
+
+    int _capture(const char *format, va_list args);
+    void _syslogTask();
+};
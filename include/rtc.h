@@ -31,6 +31,10 @@ protected:
     i2c_port_t _i2c_port;
     const uint8_t _address;
     const uint8_t _reg_start;
+    int32_t _trim = 0; // ppb, positive makes the oscillator faster
+
+    bool readRegister(uint8_t reg, uint8_t *value);
+    bool writeRegister(uint8_t reg, uint8_t value);
 
 public:
     static Rtc* detect();
@@ -38,13 +42,20 @@ public:
     virtual bool begin();
     virtual ~Rtc();
     struct timeval GetTime();
+    struct timeval GetTimeAligned(int32_t *alignmentError);
     void SetTime(struct timeval now);
+
+    // changes the oscillator rate by ppb (positive makes it faster), returns the change actually applied
+    virtual int32_t Trim(int32_t ppb);
+    int32_t GetTrim();
 };
 
 class RtcDS3231 : public Rtc
 {
 public:
     RtcDS3231();
+    bool begin();
+    int32_t Trim(int32_t ppb);
 };
 
 class RtcRX8130 : public Rtc
@@ -52,4 +63,5 @@ class RtcRX8130 : public Rtc
 public:
     RtcRX8130();
     bool begin();
+    int32_t Trim(int32_t ppb);
 };
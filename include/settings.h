@@ -21,6 +21,11 @@
 
 #include <stdio.h>
 #include <lwip/ip4_addr.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#define SETTINGS_COMMIT_DELAY_MS 2000
 
 typedef enum
 {
@@ -29,6 +34,30 @@ typedef enum
     TIMESOURCE_GPS = 2
 } timesource_t;
 
+typedef enum
+{
+    SETTING_ADMIN_PASSWORD = 1 << 0,
+    SETTING_HOSTNAME = 1 << 1,
+    SETTING_USE_DHCP = 1 << 2,
+    SETTING_LOCAL_IP = 1 << 3,
+    SETTING_NETMASK = 1 << 4,
+    SETTING_GATEWAY = 1 << 5,
+    SETTING_DNS1 = 1 << 6,
+    SETTING_DNS2 = 1 << 7,
+    SETTING_TIMESOURCES = 1 << 8,
+    SETTING_DCF_OFFSET = 1 << 9,
+    SETTING_DCF_CALIBRATION = 1 << 10,
+    SETTING_GPS_BAUDRATE = 1 << 11,
+    SETTING_GPS_PPS_PIN = 1 << 12,
+    SETTING_NTP_SERVER = 1 << 13,
+    SETTING_LED_BRIGHTNESS = 1 << 14,
+    SETTING_SYSLOG_SERVER = 1 << 15,
+    SETTING_SYSLOG_LEVEL = 1 << 16,
+    SETTING_LIVE_STATUS_INTERVAL = 1 << 17,
+} setting_t;
+
+typedef void (*settings_change_handler_t)(void *context, uint32_t changes);
+
 class Settings
 {
 private:
@@ -42,22 +71,40 @@ private:
   ip4_addr_t _dns1;
   ip4_addr_t _dns2;
 
-  int _timesource;
+  int _timesources;
 
   int _dcfOffset;
+  bool _dcfCalibration;
 
   int _gpsBaudrate;
+  int _gpsPpsPin;
 
   char _ntpServer[65] = {0};
 
   int _ledBrightness;
 
+  char _syslogServer[65] = {0};
+  int _syslogLevel;
+
+  int _liveStatusInterval;
+
+  uint32_t _dirty = 0; // setting_t flags of values changed since the last save
+  esp_timer_handle_t _commitTimer = NULL;
+  SemaphoreHandle_t _mutex;     // guards the values and _dirty
+  SemaphoreHandle_t _saveMutex; // serializes save()
+  settings_change_handler_t _changeHandler = NULL;
+  void *_changeHandlerContext = NULL;
+
 public:
   Settings();
   void load();
   void save();
+  void saveDeferred(uint32_t delayMs = SETTINGS_COMMIT_DELAY_MS);
   void clear();
 
+  uint32_t getDirty();
+  void setChangeHandler(settings_change_handler_t handler, void *context);
+
   char *getAdminPassword();
   void setAdminPassword(char* password);
 
@@ -71,18 +118,33 @@ public:
 
   void setNetworkSettings(char *hostname, bool useDHCP, ip4_addr_t localIP, ip4_addr_t netmask, ip4_addr_t gateway, ip4_addr_t dns1, ip4_addr_t dns2);
 
-  timesource_t getTimesource();
-  void setTimesource(timesource_t timesource);
+  int getTimesources();
+  bool isTimesourceEnabled(timesource_t timesource);
+  void setTimesources(int timesources);
 
   int getDcfOffset();
   void setDcfOffset(int offset);
+  bool getDcfCalibration();
+  void setDcfCalibration(bool dcfCalibration);
 
   int getGpsBaudrate();
   void setGpsBaudrate(int baudrate);
 
+  int getGpsPpsPin();
+  void setGpsPpsPin(int pin);
+
   char *getNtpServer();
   void setNtpServer(char *ntpServer);
 
   int getLEDBrightness();
   void setLEDBrightness(int brightness);
+
+  char *getSyslogServer();
+  void setSyslogServer(char *syslogServer);
+
+  int getSyslogLevel();
+  void setSyslogLevel(int syslogLevel);
+
+  int getLiveStatusInterval();
+  void setLiveStatusInterval(int liveStatusInterval);
 };
\ No newline at end of file
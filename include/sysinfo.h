@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include "profiler.h"
+
 typedef enum
 {
     BOARD_TYPE_REV_1_8_PUB = 0,
@@ -37,4 +39,5 @@ public:
     const char* getCurrentVersion();
     const char *getSerialNumber();
     board_type_t getBoardType();
+    Profiler *getProfiler();
 };
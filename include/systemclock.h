@@ -21,14 +21,25 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "rtc.h"
+#include "timesourceselector.h"
 
 class SystemClock
 {
 private:
     Rtc *_rtc;
     struct timeval _lastSyncTime = { .tv_sec = 0, .tv_usec = 0 };
+    clock_source_t _syncSource = CLOCK_SOURCE_NONE;
+    int32_t _lastOffset = 0; // usec, correction applied by the last accepted sample
+    TimeSourceSelector _selector;
+    SemaphoreHandle_t _mutex;
     TaskHandle_t _tHandle = NULL;
+    int32_t _rtcAlignmentError = -1;
+    int64_t _rtcBaseline = 0; // monotonic usec of the start of the drift window
+    int64_t _rtcCorrected = 0; // usec, offsets removed by rewriting the RTC time within the drift window
+    int64_t _lastRtcCheck = 0;
+    int32_t _rtcDrift = 0;    // ppb, positive if the RTC runs fast
 
 public:
     SystemClock(Rtc *rtc);
@@ -36,8 +47,17 @@ public:
     void start();
     void stop();
 
-    void setTime(struct timeval *tv);
+    void setTime(struct timeval *tv, clock_source_t source);
     struct timeval getTime();
     struct timeval getLastSyncTime();
+    clock_source_t getSyncSource();
+    int32_t getLastOffset();
+    uint32_t getJitter();
+    int32_t getRtcAlignmentError();
+    int32_t getRtcDrift();
+    int32_t getRtcTrim();
+
+    void _updateRtc();
+    bool isSourceAvailable(clock_source_t source);
     struct tm getLocalTime();
 };
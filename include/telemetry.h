@@ -0,0 +1,101 @@
+/* 
+ *  telemetry.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sysinfo.h"
+#include "rawuartudplistener.h"
+#include "ntpserver.h"
+#include "systemclock.h"
+
+#define TELEMETRY_RESOLUTION_COUNT 3 // 1 second, 1 minute, 1 hour
+
+typedef struct
+{
+    uint16_t cpuUsage;         // 0.1 percent, average
+    uint16_t cpuUsageMax;      // 0.1 percent, highest 1 second value
+    uint16_t framesToRemote;   // 0.1 per second
+    uint16_t framesFromRemote; // 0.1 per second
+    uint16_t ntpRequests;      // 0.1 per second
+    uint16_t reserved;
+    uint32_t heapFree;         // bytes, lowest value
+    uint32_t heapLargestBlock; // bytes, lowest value
+    int32_t syncOffset;        // usec, correction of the last clock sync
+} telemetry_sample_t;
+
+typedef struct
+{
+    uint32_t cpuUsage;
+    uint16_t cpuUsageMax;
+    uint32_t framesToRemote;
+    uint32_t framesFromRemote;
+    uint32_t ntpRequests;
+    uint32_t heapFree;
+    uint32_t heapLargestBlock;
+    int64_t syncOffset;
+    uint16_t count;
+} telemetry_accumulator_t;
+
+typedef struct
+{
+    telemetry_sample_t *samples;
+    uint16_t capacity;
+    uint16_t count;
+    uint16_t next;
+    uint16_t interval; // sec per sample
+    uint32_t lastTime; // uptime in sec at the end of the newest sample
+    telemetry_accumulator_t acc;
+} telemetry_ring_t;
+
+class Telemetry
+{
+private:
+    SysInfo *_sysInfo;
+    RawUartUdpListener *_rawUartUdpListener;
+    NtpServer *_ntpServer;
+    SystemClock *_clk;
+    TaskHandle_t _tHandle = NULL;
+    SemaphoreHandle_t _mutex;
+    telemetry_ring_t _rings[TELEMETRY_RESOLUTION_COUNT];
+    uint32_t _lastFramesToRemote = 0;
+    uint32_t _lastFramesFromRemote = 0;
+    uint32_t _lastNtpRequests = 0;
+    int64_t _lastSample = 0;
+
+    void _sample(telemetry_sample_t *sample);
+
+public:
+    Telemetry(SysInfo *sysInfo, RawUartUdpListener *rawUartUdpListener, NtpServer *ntpServer, SystemClock *clk);
+
+    void start();
+    void stop();
+
+    static void add(telemetry_ring_t *ring, const telemetry_sample_t *sample, uint32_t time);
+
+    // copies up to maxCount samples of a resolution, oldest first, and returns the number copied
+    uint16_t getSamples(int resolution, telemetry_sample_t *samples, uint16_t maxCount, uint16_t *interval, uint32_t *lastTime);
+    uint16_t getCapacity(int resolution);
+
+    void _samplerTask();
+};
@@ -0,0 +1,63 @@
+/* 
+ *  timesourceselector.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef enum
+{
+    CLOCK_SOURCE_NONE = 0,
+    CLOCK_SOURCE_RTC = 1,
+    CLOCK_SOURCE_NTP = 2,
+    CLOCK_SOURCE_DCF = 3,
+    CLOCK_SOURCE_GPS = 4,
+    CLOCK_SOURCE_PPS = 5
+} clock_source_t;
+
+#define CLOCK_SOURCE_COUNT 6
+
+typedef struct
+{
+    int64_t lastSampleTime; // usec, monotonic
+    int64_t offset;         // usec, relative to the system clock
+    uint32_t jitter;        // usec
+    uint32_t sampleCount;
+} clock_source_state_t;
+
+// Scores concurrently running time sources and decides which one disciplines the system clock.
+// Does not depend on ESP-IDF, all timestamps are passed in by the caller.
+class TimeSourceSelector
+{
+private:
+    clock_source_state_t _sources[CLOCK_SOURCE_COUNT];
+    clock_source_t _selected;
+
+    void _select(int64_t now);
+
+public:
+    TimeSourceSelector();
+
+    bool addSample(clock_source_t source, int64_t offset, int64_t now);
+
+    bool isAvailable(clock_source_t source, int64_t now);
+    uint64_t getDistance(clock_source_t source, int64_t now);
+    uint32_t getJitter(clock_source_t source);
+    clock_source_t getSelected();
+};
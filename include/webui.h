@@ -26,6 +26,10 @@
 #include "radiomoduledetector.h"
 #include "rawuartudplistener.h"
 #include "ethernet.h"
+#include "gps.h"
+#include "dcf.h"
+#include "systemclock.h"
+#include "telemetry.h"
 #include "esp_http_server.h"
 
 class WebUI
@@ -34,7 +38,7 @@ private:
     httpd_handle_t _httpd_handle;
 
 public:
-    WebUI(Settings *settings, LED *statusLED, SysInfo *sysInfo, UpdateCheck *updateCheck, Ethernet *ethernet, RawUartUdpListener *rawUartUdpListener, RadioModuleConnector *radioModuleConnector, RadioModuleDetector *radioModuleDetector);
+    WebUI(Settings *settings, LED *statusLED, SysInfo *sysInfo, UpdateCheck *updateCheck, Ethernet *ethernet, RawUartUdpListener *rawUartUdpListener, RadioModuleConnector *radioModuleConnector, RadioModuleDetector *radioModuleDetector, GPS *gps, DCF *dcf, SystemClock *clk, Telemetry *telemetry);
     void start();
     void stop();
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+/* 
+ *  webuibundle.h is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+
+#define WEBUI_BUNDLE_MAGIC 0x49554248 // "HBUI"
+#define WEBUI_BUNDLE_VERSION 1
+
+#define WEBUI_BUNDLE_FLAG_GZIP 0x01
+#define WEBUI_BUNDLE_FLAG_IMMUTABLE 0x02
+
+// Layout of the web UI bundle in the spiffs partition, written by build_webui.py:
+// header, file entries, file contents. All values are little endian.
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t fileCount;
+    uint32_t totalLength;
+    uint8_t sha256[32]; // of everything after the header
+} __attribute__((packed)) webui_bundle_header_t;
+
+typedef struct
+{
+    char path[32];
+    char contentType[23];
+    uint8_t flags;
+    uint32_t offset; // from start of bundle
+    uint32_t length;
+} __attribute__((packed)) webui_bundle_entry_t;
+
+class WebUIBundle
+{
+private:
+    const esp_partition_t *_partition;
+    const esp_partition_t *_staging;
+    spi_flash_mmap_handle_t _mmapHandle;
+    const uint8_t *_data;
+    const webui_bundle_header_t *_header;
+    char _etag[19];
+
+    uint32_t _updateLength;
+    uint32_t _updateWritten;
+    uint32_t _updateErased;
+
+    esp_err_t _verifyStaged();
+
+public:
+    WebUIBundle();
+
+    bool mount();
+    void unmount();
+    bool isMounted();
+
+    const webui_bundle_entry_t *find(const char *path, size_t pathLength);
+    const char *getData(const webui_bundle_entry_t *entry);
+    const char *getETag();
+
+    esp_err_t beginUpdate();
+    esp_err_t writeUpdate(const char *data, size_t length);
+    esp_err_t endUpdate();
+};
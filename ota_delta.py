@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""Creates, applies and verifies delta OTA images for HB-RF-ETH.
+
+A delta rebuilds a new firmware image from the image running on the device
+(see include/deltadecoder.h for the format). Deltas are gzip compressed by
+default, the device decompresses and patches them while streaming.
+
+    ota_delta.py create firmware_old.bin firmware_new.bin firmware.delta.gz
+    ota_delta.py verify firmware_old.bin firmware_new.bin firmware.delta.gz
+    ota_delta.py apply firmware_old.bin firmware.delta.gz firmware_new.bin
+"""
+
+import argparse
+import gzip
+import hashlib
+import struct
+import sys
+
+MAGIC = 0x4c444248
+VERSION = 1
+HEADER = struct.Struct("<IHHI32sI")
+
+OP_END = 0
+OP_DIFF = 1
+OP_INSERT = 2
+
+KEY_SIZE = 8
+INDEX_STEP = 4
+MIN_SCORE = 16
+MAX_NO_PROGRESS = 64
+
+
+def build_index(old):
+    index = {}
+    for pos in range(0, len(old) - KEY_SIZE + 1, INDEX_STEP):
+        index.setdefault(old[pos:pos + KEY_SIZE], pos)
+    return index
+
+
+def extend(old, new, new_pos, old_pos):
+    # like bsdiff: extend as long as more than half of the bytes match,
+    # the differences are stored as (mostly zero) diff bytes
+    matches = 0
+    best_score = 0
+    best_len = 0
+    k = 0
+    limit = min(len(new) - new_pos, len(old) - old_pos)
+    while k < limit:
+        if old[old_pos + k] == new[new_pos + k]:
+            matches += 1
+            score = 2 * matches - (k + 1)
+            if score > best_score:
+                best_score = score
+                best_len = k + 1
+        k += 1
+        if k - best_len > MAX_NO_PROGRESS:
+            break
+    return best_len, best_score
+
+
+def create(old, new):
+    index = build_index(old)
+    ops = []
+    literal_start = 0
+    shift = None
+    pos = 0
+
+    while pos < len(new):
+        candidates = []
+        if shift is not None and 0 <= pos + shift < len(old):
+            candidates.append(pos + shift)
+        found = index.get(new[pos:pos + KEY_SIZE])
+        if found is not None:
+            candidates.append(found)
+
+        best = (0, 0, None)
+        for old_pos in candidates:
+            length, score = extend(old, new, pos, old_pos)
+            if score > best[1]:
+                best = (length, score, old_pos)
+
+        length, score, old_pos = best
+        if score < MIN_SCORE:
+            pos += 1
+            continue
+
+        if literal_start < pos:
+            ops.append((OP_INSERT, new[literal_start:pos]))
+        diff = bytes((new[pos + i] - old[old_pos + i]) & 0xff for i in range(length))
+        ops.append((OP_DIFF, old_pos, diff))
+        shift = old_pos - pos
+        pos += length
+        literal_start = pos
+
+    if literal_start < len(new):
+        ops.append((OP_INSERT, new[literal_start:]))
+
+    out = bytearray(HEADER.pack(MAGIC, VERSION, 0, len(old), hashlib.sha256(old).digest(), len(new)))
+    for op in ops:
+        if op[0] == OP_DIFF:
+            out += struct.pack("<BII", OP_DIFF, op[1], len(op[2]))
+            out += op[2]
+        else:
+            out += struct.pack("<BI", OP_INSERT, len(op[1]))
+            out += op[1]
+    out += struct.pack("<B", OP_END)
+    return bytes(out)
+
+
+def apply(old, delta):
+    if delta[:2] == b"\x1f\x8b":
+        delta = gzip.decompress(delta)
+
+    magic, version, _, source_length, source_sha256, target_length = HEADER.unpack_from(delta, 0)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("not a delta")
+    if hashlib.sha256(old[:source_length]).digest() != source_sha256:
+        raise ValueError("delta was created against a different source image")
+
+    new = bytearray()
+    pos = HEADER.size
+    while True:
+        op = delta[pos]
+        if op == OP_END:
+            break
+        elif op == OP_DIFF:
+            old_pos, length = struct.unpack_from("<II", delta, pos + 1)
+            pos += 9
+            new += bytes((old[old_pos + i] + delta[pos + i]) & 0xff for i in range(length))
+        elif op == OP_INSERT:
+            (length,) = struct.unpack_from("<I", delta, pos + 1)
+            pos += 5
+            new += delta[pos:pos + length]
+        else:
+            raise ValueError("invalid op %d" % op)
+        pos += length
+
+    if len(new) != target_length:
+        raise ValueError("size mismatch")
+    return bytes(new)
+
+
+def read(path):
+    with open(path, "rb") as fp:
+        return fp.read()
+
+
+def verify(old, new, delta):
+    if apply(old, delta) != new:
+        raise ValueError("delta does not reproduce the new image")
+    print("Delta verified: %d bytes for a %d byte image (%.1f%%)" % (len(delta), len(new), 100.0 * len(delta) / len(new)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Delta OTA images for HB-RF-ETH")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("create", help="create a delta from old to new and verify it")
+    p.add_argument("old")
+    p.add_argument("new")
+    p.add_argument("delta")
+    p.add_argument("--no-gzip", action="store_true", help="do not compress the delta")
+
+    p = sub.add_parser("verify", help="check that a delta turns old into new")
+    p.add_argument("old")
+    p.add_argument("new")
+    p.add_argument("delta")
+
+    p = sub.add_parser("apply", help="rebuild new from old and a delta")
+    p.add_argument("old")
+    p.add_argument("delta")
+    p.add_argument("new")
+
+    args = parser.parse_args()
+
+    try:
+        if args.command == "create":
+            old = read(args.old)
+            new = read(args.new)
+            delta = create(old, new)
+            if not args.no_gzip:
+                delta = gzip.compress(delta, 9)
+            verify(old, new, delta)
+            with open(args.delta, "wb") as fp:
+                fp.write(delta)
+        elif args.command == "verify":
+            verify(read(args.old), read(args.new), read(args.delta))
+        else:
+            with open(args.new, "wb") as fp:
+                fp.write(apply(read(args.old), read(args.delta)))
+    except ValueError as e:
+        print("Error: %s" % e, file=sys.stderr)
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -19,25 +19,56 @@
 
 #include "dcf.h"
 #include <sys/time.h>
+#include <stdlib.h>
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "driver/gpio.h"
+#include "driver/rmt.h"
 #include "pins.h"
+#include "dcfdecoder.h"
+#include "dcfcalibration.h"
+#include "calendar.h"
+#include "profiler.h"
+
+#define DCF_RMT_CHANNEL RMT_CHANNEL_0
+#define DCF_RMT_CLK_DIV 100          // REF_TICK (1 MHz) / 100 => 100 usec per tick
+#define DCF_RMT_IDLE_THRESHOLD 5000  // ticks, a frame ends 500 msec after the last edge
+#define DCF_RMT_TICK_LENGTH 100      // usec
+#define DCF_GLITCH_LENGTH 20000      // usec, shorter levels are treated as noise
+#define DCF_RMT_FILTER_THRESHOLD 255 // APB cycles (~3 usec) regardless of the channel clock, only removes electrical spikes
+#define DCF_RMT_MAX_RESIDUAL 50000   // usec, a second mark further off the tracked grid starts a new one
+#define DCF_RMT_PHASE_GAIN 8         // the grid follows a second mark with 1/8 of its residual
+
+#define DCF_CALIBRATION_REFERENCE_AGE 60000000 // usec, the local clock drifts away from the reference afterwards
+#define DCF_CALIBRATION_MAX_DEVIATION 20000    // usec
+#define DCF_CALIBRATION_MIN_CHANGE 1000        // usec, smaller changes are not persisted
 
 static SystemClock *_clk;
 static Settings *_settings;
 
-static uint64_t _buffer = 0;
-static uint8_t _bufferPos = 0;
-
-static int64_t _previousSecondMark = 0;
+static DcfDecoder _decoder;
 static int64_t _secondMark = 0;
 
-static QueueHandle_t _flank_queue;
+static DcfCalibration _calibration;
+static bool _calibrating = false;
+
+static QueueHandle_t _flank_queue = NULL;
 static TaskHandle_t _queueHandlerTask;
 
+static bool _useRmt = false;
+static RingbufHandle_t _rmt_ringbuf = NULL;
+static int64_t _rmtSecondMark = 0; // tracked second mark of the last RMT frame, 0 if unknown
+
+static volatile uint32_t _interruptCount = 0;
+static volatile uint32_t _cpuTime = 0;
+static uint32_t _lastInterruptCount = 0;
+static uint32_t _lastCpuTime = 0;
+static int64_t _metricsWindowStart = 0;
+static uint32_t _interruptsPerMinute = 0;
+static uint32_t _cpuTimePerMinute = 0;
+
 static const char *TAG = "DCF";
 
 typedef struct
@@ -46,64 +77,16 @@ typedef struct
     int state;
 } flank_event_t;
 
-inline uint8_t bcd2bin(uint8_t val)
-{
-    return val - 6 * (val >> 4);
-}
-
 DCF::DCF(Settings *settings, SystemClock *clk)
 {
     _settings = settings;
     _clk = clk;
 }
 
-bool checkParity(uint8_t start, uint8_t end)
-{
-    int parity = 0;
-
-    for (int pos = start; pos <= end; pos++)
-    {
-        parity ^= (int)((_buffer >> pos) & 1);
-    }
-
-    return parity == 0;
-}
-
-int is_leap(unsigned int y)
-{
-    return (y % 4) == 0 && ((y % 100) != 0 || ((y + 1900) % 400) == 0);
-}
-
 time_t dcf2epoch(struct tm *dcf_tm, uint8_t tz)
 {
-    static const unsigned ndays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-
-    time_t res = 0;
-    int i;
-
-    for (i = 70; i < dcf_tm->tm_year; ++i)
-    {
-        res += is_leap(i) ? 366 : 365;
-    }
-
-    for (i = 0; i < dcf_tm->tm_mon; ++i)
-    {
-        res += ndays[i];
-        if (i == 1 && is_leap(dcf_tm->tm_year))
-        {
-            res++;
-        }
-    }
-
-    res += dcf_tm->tm_mday - 1;
-    res *= 24;
-    res += dcf_tm->tm_hour;
-    res -= tz ^ 3;
-    res *= 60;
-    res += dcf_tm->tm_min;
-    res *= 60;
-
-    return res;
+    // tz is 1 for CEST (UTC+2) and 2 for CET (UTC+1)
+    return epochFromCivil(dcf_tm->tm_year + 1900, dcf_tm->tm_mon + 1, dcf_tm->tm_mday, dcf_tm->tm_hour - (tz ^ 3), dcf_tm->tm_min, 0);
 }
 
 static void IRAM_ATTR onPinChange(void *arg)
@@ -118,86 +101,132 @@ static void IRAM_ATTR onPinChange(void *arg)
     BaseType_t xHigherPriorityTaskWokenByPost = pdFALSE;
     xQueueSendFromISR(_flank_queue, &event, &xHigherPriorityTaskWokenByPost);
 
+    _interruptCount++;
+    _cpuTime += esp_timer_get_time() - flankTime;
+
     if (xHigherPriorityTaskWokenByPost)
     {
         portYIELD_FROM_ISR();
     }
 }
 
+static bool isReferenceSelected()
+{
+    clock_source_t source = _clk->getSyncSource();
+
+    switch (source)
+    {
+    case CLOCK_SOURCE_NTP:
+    case CLOCK_SOURCE_GPS:
+    case CLOCK_SOURCE_PPS:
+        return _clk->isSourceAvailable(source);
+    default:
+        return false;
+    }
+}
+
+static void calibrate(int64_t secondMark, int64_t pulseLength)
+{
+    if (!_decoder.isLocked() || pulseLength < 40000 || pulseLength > 300000 || !isReferenceSelected())
+        return;
+
+    struct timeval now = _clk->getTime();
+    struct timeval lastSync = _clk->getLastSyncTime();
+    int64_t age = (now.tv_sec - lastSync.tv_sec) * 1000000LL + now.tv_usec - lastSync.tv_usec;
+
+    if (age > DCF_CALIBRATION_REFERENCE_AGE)
+        return;
+
+    // the second mark is sent at the start of the second, anything behind is receiver delay
+    int64_t delay = (now.tv_usec - (esp_timer_get_time() - secondMark)) % 1000000;
+    if (delay < -500000)
+        delay += 1000000;
+    else if (delay >= 500000)
+        delay -= 1000000;
+
+    if (!_calibration.addSample(delay))
+        return;
+
+    int32_t offset = _calibration.getOffset();
+
+    if (_calibration.getDeviation() > DCF_CALIBRATION_MAX_DEVIATION)
+    {
+        ESP_LOGW(TAG, "DCF calibration too noisy (offset %d usec, deviation %d usec), retrying", offset, _calibration.getDeviation());
+        return;
+    }
+
+    ESP_LOGI(TAG, "Calibrated DCF offset to %d +/- %d usec (deviation %d usec)", offset, _calibration.getConfidence(), _calibration.getDeviation());
+    _calibrating = false;
+
+    if (abs(offset - _settings->getDcfOffset()) >= DCF_CALIBRATION_MIN_CHANGE)
+    {
+        _settings->setDcfOffset(offset);
+        _settings->save();
+    }
+}
+
 static void handlePinChange(int64_t flankTime, int state)
 {
     if (state)
     {
         // end of pulse
-        int64_t secondLength = _secondMark - _previousSecondMark;
         int64_t pulseLength = flankTime - _secondMark;
+        dcf_time_t time;
 
-        uint64_t pulseValue;
-        if (pulseLength > 80000 && pulseLength < 135000)
-        {
-            pulseValue = 0;
-        }
-        else if (pulseLength > 180000 && pulseLength < 235000)
-        {
-            pulseValue = 1;
-        }
-        else
-        {
-            ESP_LOGE(TAG, "Invalid pulse: %llu %llu", secondLength / 1000ULL, pulseLength / 1000ULL);
-            return; // invalid pulse length
-        }
+        bool decoded = _decoder.addPulse(_secondMark, pulseLength, &time);
 
-        if (secondLength > 970000 && secondLength < 1035000)
+        if (_calibrating)
         {
-            if (_bufferPos < 59)
-            {
-                _bufferPos++;
-                _buffer |= (pulseValue << _bufferPos);
-            }
+            calibrate(_secondMark, pulseLength);
+
+            // keep the reference selected until the offset is known
+            if (isReferenceSelected())
+                return;
         }
-        else if (secondLength > 1970000 && secondLength < 2035000)
-        {
-            uint8_t timezone = (uint8_t)((_buffer >> 17) & 3);
 
-            if (_bufferPos < 58 || _bufferPos > 59 || (int)(_buffer & 1) != 0 || (int)((_buffer >> 20) & 1) != 1 || timezone == 0 || timezone == 3 || !checkParity(21, 28) || !checkParity(29, 35) || !checkParity(36, 58))
-            {
-                ESP_LOGE(TAG, "Received invalid frame");
-            }
-            else
-            {
-                struct tm dcf_tm;
-                dcf_tm.tm_year = 100 + bcd2bin((int)((_buffer >> 50) & 0xff));
-                dcf_tm.tm_mon = bcd2bin((int)((_buffer >> 45) & 0x1f)) - 1;
-                dcf_tm.tm_mday = bcd2bin((int)((_buffer >> 36) & 0x3f));
-                dcf_tm.tm_hour = bcd2bin((int)((_buffer >> 29) & 0x3f));
-                dcf_tm.tm_min = bcd2bin((int)((_buffer >> 21) & 0x7f));
-                dcf_tm.tm_sec = 0;
-
-                struct timeval tv;
-                tv.tv_sec = dcf2epoch(&dcf_tm, timezone);
-                tv.tv_usec = esp_timer_get_time() - _secondMark + _settings->getDcfOffset();
-
-                ESP_LOGI(TAG, "Updated time to %02d-%02d-%02d %02d:%02d:%02d.%06ld %s", dcf_tm.tm_year + 1900, dcf_tm.tm_mon + 1, dcf_tm.tm_mday, dcf_tm.tm_hour, dcf_tm.tm_min, dcf_tm.tm_sec, tv.tv_usec, timezone == 2 ? "CET" : "CEST");
-                _clk->setTime(&tv);
-            }
+        if (!decoded)
+            return;
 
-            _buffer = pulseValue;
-            _bufferPos = 0;
-        }
-        else
-        {
-            ESP_LOGE(TAG, "Invalid second: %llu %llu", secondLength / 1000ULL, pulseLength / 1000ULL);
-            return; // invalid second length
-        }
+        struct tm dcf_tm;
+        dcf_tm.tm_year = time.year - 1900;
+        dcf_tm.tm_mon = time.month - 1;
+        dcf_tm.tm_mday = time.day;
+        dcf_tm.tm_hour = time.hour;
+        dcf_tm.tm_min = time.minute;
+        dcf_tm.tm_sec = time.second;
+
+        struct timeval tv;
+        tv.tv_sec = dcf2epoch(&dcf_tm, time.timezone) + time.second;
+        tv.tv_usec = esp_timer_get_time() - _secondMark + _settings->getDcfOffset();
+
+        ESP_LOGI(TAG, "Updated time to %02d-%02d-%02d %02d:%02d:%02d.%06ld %s", dcf_tm.tm_year + 1900, dcf_tm.tm_mon + 1, dcf_tm.tm_mday, dcf_tm.tm_hour, dcf_tm.tm_min, dcf_tm.tm_sec, tv.tv_usec, time.timezone == 2 ? "CET" : "CEST");
+        _clk->setTime(&tv, CLOCK_SOURCE_DCF);
     }
     else
     {
         // start of pulse
-        _previousSecondMark = _secondMark;
         _secondMark = flankTime;
     }
 }
 
+static void updateMetrics(int64_t now)
+{
+    int64_t elapsed = now - _metricsWindowStart;
+
+    if (elapsed >= 60000000)
+    {
+        uint32_t interruptCount = _interruptCount;
+        uint32_t cpuTime = _cpuTime;
+
+        _interruptsPerMinute = (interruptCount - _lastInterruptCount) * 60000000LL / elapsed;
+        _cpuTimePerMinute = (cpuTime - _lastCpuTime) * 60000000LL / elapsed;
+
+        _lastInterruptCount = interruptCount;
+        _lastCpuTime = cpuTime;
+        _metricsWindowStart = now;
+    }
+}
+
 static void flankEventQueueHandler(void *arg)
 {
     flank_event_t event;
@@ -206,15 +235,154 @@ static void flankEventQueueHandler(void *arg)
     {
         if (xQueueReceive(_flank_queue, &event, portMAX_DELAY) == pdTRUE)
         {
+            int64_t start = esp_timer_get_time();
             handlePinChange(event.flankTime, event.state);
+            _cpuTime += esp_timer_get_time() - start;
+
+            updateMetrics(start);
         }
     }
 
     vTaskDelete(NULL);
 }
 
+// The RMT can not timestamp a frame, only the receive time of the task is known. It is late by the scheduling latency,
+// so it only decides how many whole seconds passed since the last frame. The phase of the second marks follows it slowly,
+// which keeps up with the drift of the local oscillator but not with the jitter of the task.
+static int64_t trackSecondMark(int64_t measured)
+{
+    if (_rmtSecondMark != 0)
+    {
+        int64_t seconds = (measured - _rmtSecondMark + 500000) / 1000000;
+        int64_t predicted = _rmtSecondMark + seconds * 1000000;
+        int64_t residual = measured - predicted;
+
+        if (seconds > 0 && residual > -DCF_RMT_MAX_RESIDUAL && residual < DCF_RMT_MAX_RESIDUAL)
+        {
+            _rmtSecondMark = predicted + residual / DCF_RMT_PHASE_GAIN;
+            return _rmtSecondMark;
+        }
+    }
+
+    _rmtSecondMark = measured;
+    return measured;
+}
+
+// A RMT frame starts with the falling edge of the pulse and ends after DCF_RMT_IDLE_THRESHOLD without edges.
+// Pulse position and length are taken from the item durations only.
+static void handleRmtItems(rmt_item32_t *items, size_t count, int64_t frameEndTime)
+{
+    int64_t pos = 0, runStart = -1, runEnd = -1;
+    bool found = false;
+
+    for (size_t i = 0; i < count * 2; i++)
+    {
+        uint32_t level = (i & 1) ? items[i / 2].level1 : items[i / 2].level0;
+        int64_t duration = ((i & 1) ? items[i / 2].duration1 : items[i / 2].duration0) * DCF_RMT_TICK_LENGTH;
+
+        // end marker, or the idle level which ended the frame
+        if (duration == 0 || (level != 0 && duration >= DCF_RMT_IDLE_THRESHOLD * DCF_RMT_TICK_LENGTH))
+            break;
+
+        if (!found)
+        {
+            if (level == 0)
+            {
+                // low levels form the pulse, interrupted only by short high glitches
+                if (runStart < 0)
+                    runStart = pos;
+                runEnd = pos + duration;
+            }
+            else if (duration >= DCF_GLITCH_LENGTH && runStart >= 0)
+            {
+                if (runEnd - runStart >= DCF_GLITCH_LENGTH)
+                    found = true;
+                else
+                    runStart = -1; // short low glitch
+            }
+        }
+
+        pos += duration;
+    }
+
+    if (runStart < 0 || runEnd - runStart < DCF_GLITCH_LENGTH)
+    {
+        ESP_LOGD(TAG, "Ignoring RMT frame without pulse");
+        return;
+    }
+
+    // pos is the last edge of the frame
+    int64_t secondMark = trackSecondMark(frameEndTime - DCF_RMT_IDLE_THRESHOLD * DCF_RMT_TICK_LENGTH - pos + runStart);
+
+    handlePinChange(secondMark, 0);
+    handlePinChange(secondMark + runEnd - runStart, 1);
+}
+
+static void rmtReceiveHandler(void *arg)
+{
+    for (;;)
+    {
+        size_t length = 0;
+        rmt_item32_t *items = (rmt_item32_t *)xRingbufferReceive(_rmt_ringbuf, &length, portMAX_DELAY);
+        int64_t receiveTime = esp_timer_get_time();
+
+        if (items == NULL)
+            continue;
+
+        handleRmtItems(items, length / sizeof(rmt_item32_t), receiveTime);
+        vRingbufferReturnItem(_rmt_ringbuf, (void *)items);
+
+        _interruptCount++;
+        _cpuTime += esp_timer_get_time() - receiveTime;
+
+        updateMetrics(receiveTime);
+    }
+
+    vTaskDelete(NULL);
+}
+
+static bool startRmtCapture()
+{
+    rmt_config_t rmt_rx_config = RMT_DEFAULT_CONFIG_RX(DCF_PIN, DCF_RMT_CHANNEL);
+    rmt_rx_config.clk_div = DCF_RMT_CLK_DIV;
+    rmt_rx_config.mem_block_num = 2;
+    rmt_rx_config.flags = RMT_CHANNEL_FLAGS_AWARE_DFS; // REF_TICK as source clock
+    rmt_rx_config.rx_config.filter_en = true;
+    rmt_rx_config.rx_config.filter_ticks_thresh = DCF_RMT_FILTER_THRESHOLD; // glitches are merged in handleRmtItems
+    rmt_rx_config.rx_config.idle_threshold = DCF_RMT_IDLE_THRESHOLD;
+
+    if (rmt_config(&rmt_rx_config) != ESP_OK || rmt_driver_install(DCF_RMT_CHANNEL, 1024, 0) != ESP_OK)
+    {
+        return false;
+    }
+
+    rmt_get_ringbuf_handle(DCF_RMT_CHANNEL, &_rmt_ringbuf);
+    xTaskCreate(rmtReceiveHandler, "DCF_RMT_ReceiveHandler", 4096, NULL, 17, &_queueHandlerTask);
+    rmt_rx_start(DCF_RMT_CHANNEL, true);
+
+    return true;
+}
+
 void DCF::start()
 {
+    _metricsWindowStart = esp_timer_get_time();
+
+    _calibration.reset();
+    _calibrating = _settings->getDcfCalibration() && _settings->isTimesourceEnabled(TIMESOURCE_NTP);
+
+    // measure pulses in hardware, one event per second instead of an interrupt per edge
+    _rmtSecondMark = 0;
+    _useRmt = startRmtCapture();
+    if (_useRmt)
+    {
+        // the receive task shows up in the task list of the profiler, there is no ISR of our own
+        ESP_LOGI(TAG, "Using RMT pulse capture");
+        return;
+    }
+
+    ESP_LOGW(TAG, "RMT not available, using GPIO interrupts");
+    Profiler::registerIsr("dcf", &_interruptCount, &_cpuTime);
+
     _flank_queue = xQueueCreate(8, sizeof(flank_event_t));
     xTaskCreate(flankEventQueueHandler, "DFC_FlankEvent_QueueHandler", 4096, NULL, 17, &_queueHandlerTask);
 
@@ -232,7 +400,42 @@ void DCF::start()
 
 void DCF::stop()
 {
+    if (_useRmt)
+    {
+        rmt_rx_stop(DCF_RMT_CHANNEL);
+        vTaskDelete(_queueHandlerTask);
+        rmt_driver_uninstall(DCF_RMT_CHANNEL);
+        _rmt_ringbuf = NULL;
+        return;
+    }
+
     gpio_isr_handler_remove(DCF_PIN);
-    xQueueReset(_flank_queue);
     vTaskDelete(_queueHandlerTask);
+    vQueueDelete(_flank_queue);
+    _flank_queue = NULL;
+}
+
+uint32_t DCF::getInterruptsPerMinute()
+{
+    return _interruptsPerMinute;
+}
+
+uint32_t DCF::getCpuTimePerMinute()
+{
+    return _cpuTimePerMinute;
+}
+
+bool DCF::isCalibrating()
+{
+    return _calibrating;
+}
+
+int DCF::getCalibrationSampleCount()
+{
+    return _calibration.getSampleCount();
+}
+
+int32_t DCF::getCalibrationDeviation()
+{
+    return _calibration.getDeviation();
 }
@@ -0,0 +1,87 @@
+/* 
+ *  dcfcalibration.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include "dcfcalibration.h"
+#include <stdlib.h>
+#include <math.h>
+
+static int compareSamples(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a;
+    int32_t y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+DcfCalibration::DcfCalibration()
+{
+    _offset = 0;
+    _deviation = 0;
+    _confidence = 0;
+    reset();
+}
+
+void DcfCalibration::reset()
+{
+    _sampleCount = 0;
+}
+
+bool DcfCalibration::addSample(int32_t delay)
+{
+    _samples[_sampleCount++] = delay;
+
+    if (_sampleCount < DCF_CALIBRATION_SAMPLES)
+        return false;
+
+    qsort(_samples, _sampleCount, sizeof(int32_t), compareSamples);
+    _offset = _samples[_sampleCount / 2];
+
+    for (int i = 0; i < _sampleCount; i++)
+    {
+        _samples[i] = abs(_samples[i] - _offset);
+    }
+    qsort(_samples, _sampleCount, sizeof(int32_t), compareSamples);
+
+    // MAD scaled to the standard deviation of a normal distribution
+    _deviation = (int32_t)(1.4826f * _samples[_sampleCount / 2]);
+    // standard error of the median
+    _confidence = (int32_t)(1.2533f * _deviation / sqrtf(_sampleCount));
+
+    _sampleCount = 0;
+    return true;
+}
+
+int DcfCalibration::getSampleCount()
+{
+    return _sampleCount;
+}
+
+int32_t DcfCalibration::getOffset()
+{
+    return _offset;
+}
+
+int32_t DcfCalibration::getDeviation()
+{
+    return _deviation;
+}
+
+int32_t DcfCalibration::getConfidence()
+{
+    return _confidence;
+}
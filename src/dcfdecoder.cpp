@@ -0,0 +1,354 @@
+/* 
+ *  dcfdecoder.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include "dcfdecoder.h"
+#include "calendar.h"
+#include <string.h>
+#include <limits.h>
+
+#define DCF_SECOND 1000000LL
+#define DCF_MAX_SECOND_DEVIATION 50000 // usec
+#define DCF_MIN_PULSE_LENGTH 40000     // usec, shorter pulses are glitches
+#define DCF_MAX_PULSE_LENGTH 300000    // usec, longer pulses carry no information
+#define DCF_MIN_MARGIN 300             // one and a half strong bits between the best and the second best value
+#define DCF_MIN_CLEAN_BIT 75           // soft bit of a clear 0 (75..112 msec) or 1 (188..225 msec)
+
+static int8_t softBit(int64_t pulseLength)
+{
+    // 100 msec is a 0 (-100), 200 msec is a 1 (100), the confidence drops again for pulses beyond the nominal lengths
+    if (pulseLength > DCF_MAX_PULSE_LENGTH)
+        return 0;
+
+    int64_t value;
+    if (pulseLength < 100000)
+        value = -100 + (100000 - pulseLength) / 1000;
+    else if (pulseLength > 200000)
+        value = 100 - (pulseLength - 200000) / 1000;
+    else
+        value = (pulseLength - 150000) / 500;
+    return (int8_t)value;
+}
+
+static int parity(int value)
+{
+    int res = 0;
+    for (; value; value >>= 1)
+        res ^= value & 1;
+    return res;
+}
+
+static int correlate(const int8_t *bits, int startBit, int count, int value)
+{
+    int res = 0;
+    for (int i = 0; i < count; i++)
+    {
+        res += ((value >> i) & 1) ? bits[startBit + i] : -bits[startBit + i];
+    }
+    return res;
+}
+
+static bool matches(const int8_t *bits, int startBit, int count, int value)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int bit = bits[startBit + i];
+        if (((value >> i) & 1) ? bit < DCF_MIN_CLEAN_BIT : bit > -DCF_MIN_CLEAN_BIT)
+            return false;
+    }
+    return true;
+}
+
+DcfDecoder::DcfDecoder()
+{
+    reset();
+}
+
+void DcfDecoder::reset()
+{
+    memset(_slots, 0, sizeof(_slots));
+    memset(_gapScore, 0, sizeof(_gapScore));
+    _historyCount = 0;
+    _lastPulse = 0;
+    _lastSlot = 0;
+    _phase = -1;
+    _rejectedPulses = 0;
+    _lastDecodedMinute = 0;
+    _lastDecodedIndex = 0;
+}
+
+bool DcfDecoder::isLocked()
+{
+    return _phase >= 0;
+}
+
+void DcfDecoder::_updatePhase(int64_t slot)
+{
+    int best = 0;
+    uint8_t secondBest = 0;
+
+    for (int i = 1; i < 60; i++)
+    {
+        if (_gapScore[i] > _gapScore[best])
+        {
+            secondBest = _gapScore[best];
+            best = i;
+        }
+        else if (_gapScore[i] > secondBest)
+        {
+            secondBest = _gapScore[i];
+        }
+    }
+
+    // a single gap is only trusted after a full minute without any other missing pulse
+    if (_gapScore[best] <= secondBest || (_gapScore[best] < 2 && slot < 60))
+        return;
+
+    if (best != _phase)
+    {
+        // frames of the old phase are garbage
+        _historyCount = 0;
+        _phase = best;
+    }
+}
+
+void DcfDecoder::_addFrame(int64_t slot)
+{
+    if (_historyCount == DCF_HISTORY_LENGTH)
+    {
+        memmove(_history, _history + 1, sizeof(dcf_frame_t) * (DCF_HISTORY_LENGTH - 1));
+        _historyCount--;
+    }
+
+    // slot is the first second of the new minute, _slots still contains the previous one
+    dcf_frame_t *frame = &_history[_historyCount++];
+    for (int i = 0; i < 60; i++)
+    {
+        frame->bits[i] = _slots[(slot + i) % 60];
+    }
+    frame->minuteIndex = (uint32_t)(slot / 60);
+}
+
+// sum of the correlation of all frames with the expected value at their time
+int DcfDecoder::_score(dcf_field_t field, int value, int startBit, int bits, int parityBit, int minute, int hour)
+{
+    uint32_t current = _history[_historyCount - 1].minuteIndex;
+    int res = 0;
+
+    for (int i = 0; i < _historyCount; i++)
+    {
+        const int8_t *frameBits = _history[i].bits;
+        int age = current - _history[i].minuteIndex;
+        int expected;
+
+        if (field == DCF_FIELD_MINUTE)
+        {
+            expected = ((value - age) % 60 + 60) % 60;
+        }
+        else if (field == DCF_FIELD_HOUR)
+        {
+            expected = (((value * 60 + minute - age) % 1440 + 1440) % 1440) / 60;
+        }
+        else
+        {
+            // only frames of the same day, every candidate is scored against the same frames
+            if (hour * 60 + minute - age < 0)
+                continue;
+
+            expected = value;
+        }
+
+        int bcd = bin2bcd(expected);
+        res += correlate(frameBits, startBit, bits, bcd);
+        if (parityBit >= 0)
+            res += parity(bcd) ? frameBits[parityBit] : -frameBits[parityBit];
+    }
+
+    return res;
+}
+
+bool DcfDecoder::_bestValue(dcf_field_t field, int first, int last, int startBit, int bits, int parityBit, int minute, int hour, int minMargin, int *value)
+{
+    int best = INT_MIN, secondBest = INT_MIN;
+
+    for (int candidate = first; candidate <= last; candidate++)
+    {
+        int score = _score(field, candidate, startBit, bits, parityBit, minute, hour);
+
+        if (score > best)
+        {
+            secondBest = best;
+            best = score;
+            *value = candidate;
+        }
+        else if (score > secondBest)
+        {
+            secondBest = score;
+        }
+    }
+
+    return best > 0 && best - secondBest >= minMargin;
+}
+
+bool DcfDecoder::_decode(dcf_time_t *time, int minMargin)
+{
+    int minute = 0, hour = 0, day = 0, weekday = 0, month = 0, year = 0;
+
+    if (!_bestValue(DCF_FIELD_MINUTE, 0, 59, 21, 7, 28, 0, 0, minMargin, &minute))
+        return false;
+    if (!_bestValue(DCF_FIELD_HOUR, 0, 23, 29, 6, 35, minute, 0, minMargin, &hour))
+        return false;
+    if (!_bestValue(DCF_FIELD_DATE, 1, 31, 36, 6, -1, minute, hour, minMargin, &day))
+        return false;
+    if (!_bestValue(DCF_FIELD_DATE, 1, 12, 45, 5, -1, minute, hour, minMargin, &month))
+        return false;
+    if (!_bestValue(DCF_FIELD_DATE, 0, 99, 50, 8, -1, minute, hour, minMargin, &year))
+        return false;
+
+    // weekday is not needed, but it is part of the date parity and has to match the date
+    if (!_bestValue(DCF_FIELD_DATE, 1, 7, 42, 3, -1, minute, hour, minMargin, &weekday))
+        return false;
+
+    int32_t days = daysFromCivil(2000 + year, month, day);
+    if (dayFromDays(days) != (unsigned)day || weekdayFromDays(days) != (unsigned)weekday % 7)
+        return false;
+
+    int dateParity = parity(bin2bcd(day)) ^ parity(bin2bcd(weekday)) ^ parity(bin2bcd(month)) ^ parity(bin2bcd(year));
+    int markers = 0, dateParityScore = 0, timezone = 0;
+
+    for (int i = 0; i < _historyCount; i++)
+    {
+        const int8_t *bits = _history[i].bits;
+        markers += bits[20] - bits[0];
+        timezone += bits[17] - bits[18];
+        dateParityScore += dateParity ? bits[58] : -bits[58];
+    }
+
+    if (markers <= 0 || (timezone < minMargin && timezone > -minMargin) || dateParityScore <= 0)
+        return false;
+
+    time->year = 2000 + year;
+    time->month = month;
+    time->day = day;
+    time->hour = hour;
+    time->minute = minute;
+    time->timezone = timezone > 0 ? 1 : 2;
+
+    return true;
+}
+
+// a decode is only reported if the frame before decoded to the minute before, so a single bad vote never sets the clock
+bool DcfDecoder::_confirm(const dcf_time_t *time)
+{
+    int64_t decodedMinute = epochFromCivil(time->year, time->month, time->day, time->hour, time->minute, 0) / 60 - (time->timezone == 1 ? 120 : 60);
+    uint32_t index = _history[_historyCount - 1].minuteIndex;
+    bool confirmed = _lastDecodedIndex + 1 == index && _lastDecodedMinute + 1 == decodedMinute;
+
+    _lastDecodedMinute = decodedMinute;
+    _lastDecodedIndex = index;
+
+    return confirmed;
+}
+
+// a frame whose bits are all clearly 0 or 1 and which carries the decoded time with valid parities is trusted on its own
+bool DcfDecoder::_isClean(const dcf_time_t *time)
+{
+    const int8_t *bits = _history[_historyCount - 1].bits;
+
+    int minute = bin2bcd(time->minute);
+    int hour = bin2bcd(time->hour);
+    int day = bin2bcd(time->day);
+    int weekday = bin2bcd((weekdayFromDays(daysFromCivil(time->year, time->month, time->day)) + 6) % 7 + 1);
+    int month = bin2bcd(time->month);
+    int year = bin2bcd(time->year - 2000);
+    int dateParity = parity(day) ^ parity(weekday) ^ parity(month) ^ parity(year);
+
+    return matches(bits, 0, 1, 0) && matches(bits, 17, 2, time->timezone) && matches(bits, 20, 1, 1) &&
+           matches(bits, 21, 7, minute) && matches(bits, 28, 1, parity(minute)) &&
+           matches(bits, 29, 6, hour) && matches(bits, 35, 1, parity(hour)) &&
+           matches(bits, 36, 6, day) && matches(bits, 42, 3, weekday) && matches(bits, 45, 5, month) &&
+           matches(bits, 50, 8, year) && matches(bits, 58, 1, dateParity);
+}
+
+bool DcfDecoder::addPulse(int64_t secondMark, int64_t pulseLength, dcf_time_t *time)
+{
+    if (pulseLength < DCF_MIN_PULSE_LENGTH)
+        return false;
+
+    int64_t slot = 0;
+
+    if (_lastPulse != 0)
+    {
+        int64_t delta = secondMark - _lastPulse;
+        int64_t seconds = (delta + DCF_SECOND / 2) / DCF_SECOND;
+        int64_t deviation = delta - seconds * DCF_SECOND;
+
+        if (seconds <= 0 || deviation > DCF_MAX_SECOND_DEVIATION || deviation < -DCF_MAX_SECOND_DEVIATION)
+        {
+            // does not fit into the grid of second marks, start over only if this persists
+            if (++_rejectedPulses < 3)
+                return false;
+
+            reset();
+        }
+        else if (seconds > 120)
+        {
+            // lost the signal for too long
+            reset();
+        }
+        else
+        {
+            slot = _lastSlot + seconds;
+        }
+    }
+
+    _rejectedPulses = 0;
+
+    bool res = false;
+
+    for (int64_t s = _lastSlot + 1; s <= slot; s++)
+    {
+        _updatePhase(s);
+
+        if (_phase >= 0 && s % 60 == (_phase + 1) % 60)
+        {
+            _addFrame(s);
+            time->second = slot - s;
+            // a clean frame may resolve values the history can not separate yet
+            bool decoded = _decode(time, DCF_MIN_MARGIN);
+            bool clean = (decoded || _decode(time, 1)) && _isClean(time);
+            res = (decoded || clean) && (_confirm(time) || clean);
+        }
+
+        if (s < slot)
+        {
+            // missing pulse
+            _slots[s % 60] = 0;
+            if (_gapScore[s % 60] < UINT8_MAX)
+                _gapScore[s % 60]++;
+        }
+    }
+
+    _slots[slot % 60] = softBit(pulseLength);
+    _gapScore[slot % 60] /= 2;
+
+    _lastPulse = secondMark;
+    _lastSlot = slot;
+
+    return res;
+}
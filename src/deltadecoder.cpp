@@ -0,0 +1,297 @@
+/* 
+ *  deltadecoder.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include "deltadecoder.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "mbedtls/md.h"
+
+static const char *TAG = "DeltaDecoder";
+
+static uint32_t readUInt32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// size of an op including its opcode, unknown ops are rejected by _parseOp
+static size_t _opSize(uint8_t op)
+{
+    switch (op)
+    {
+    case DELTA_OP_DIFF:
+        return 9;
+    case DELTA_OP_INSERT:
+        return 5;
+    default:
+        return 1;
+    }
+}
+
+bool DeltaDecoder::isDelta(const char *data, size_t length)
+{
+    uint32_t magic = 0;
+    if (length >= sizeof(magic))
+        memcpy(&magic, data, sizeof(magic));
+    return magic == DELTA_MAGIC;
+}
+
+DeltaDecoder::DeltaDecoder(const esp_partition_t *source, delta_output_func_t output, void *context) : _source(source), _output(output), _context(context), _sourceBuffer(NULL), _state(STATE_HEADER), _fieldLength(0), _sourceOffset(0), _remaining(0), _outputLength(0)
+{
+}
+
+DeltaDecoder::~DeltaDecoder()
+{
+    free(_sourceBuffer);
+}
+
+esp_err_t DeltaDecoder::begin()
+{
+    if (_source == NULL)
+        return ESP_ERR_NOT_FOUND;
+
+    _sourceBuffer = (uint8_t *)malloc(DELTA_SOURCE_BUFFER_SIZE);
+    if (_sourceBuffer == NULL)
+        return ESP_ERR_NO_MEM;
+
+    return ESP_OK;
+}
+
+esp_err_t DeltaDecoder::_verifySource()
+{
+    if (_header.magic != DELTA_MAGIC || _header.version != DELTA_VERSION)
+    {
+        ESP_LOGE(TAG, "Unsupported delta");
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    if (_header.sourceLength > _source->size)
+    {
+        ESP_LOGE(TAG, "Delta was not created against the running firmware");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    mbedtls_md_context_t ctx;
+    mbedtls_md_init(&ctx);
+    mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+    mbedtls_md_starts(&ctx);
+
+    esp_err_t err = ESP_OK;
+    for (uint32_t offset = 0; offset < _header.sourceLength; offset += DELTA_SOURCE_BUFFER_SIZE)
+    {
+        size_t len = _header.sourceLength - offset;
+        if (len > DELTA_SOURCE_BUFFER_SIZE)
+            len = DELTA_SOURCE_BUFFER_SIZE;
+
+        err = esp_partition_read(_source, offset, _sourceBuffer, len);
+        if (err != ESP_OK)
+            break;
+        mbedtls_md_update(&ctx, _sourceBuffer, len);
+    }
+
+    uint8_t sha256[32];
+    mbedtls_md_finish(&ctx, sha256);
+    mbedtls_md_free(&ctx);
+
+    if (err != ESP_OK)
+        return err;
+
+    if (memcmp(sha256, _header.sourceSha256, sizeof(sha256)) != 0)
+    {
+        ESP_LOGE(TAG, "Delta was not created against the running firmware");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGI(TAG, "Applying delta to %s, target size %u", _source->label, _header.targetLength);
+    return ESP_OK;
+}
+
+esp_err_t DeltaDecoder::_parseOp()
+{
+    switch (_field[0])
+    {
+    case DELTA_OP_END:
+        if (_outputLength != _header.targetLength)
+        {
+            ESP_LOGE(TAG, "Size mismatch, expected %u, got %u", _header.targetLength, _outputLength);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        _state = STATE_DONE;
+        break;
+
+    case DELTA_OP_DIFF:
+        _sourceOffset = readUInt32(_field + 1);
+        _remaining = readUInt32(_field + 5);
+        if (_sourceOffset > _header.sourceLength || _remaining > _header.sourceLength - _sourceOffset)
+        {
+            ESP_LOGE(TAG, "Invalid source range");
+            return ESP_ERR_INVALID_ARG;
+        }
+        _state = STATE_DIFF;
+        break;
+
+    case DELTA_OP_INSERT:
+        _remaining = readUInt32(_field + 1);
+        _state = STATE_INSERT;
+        break;
+
+    default:
+        ESP_LOGE(TAG, "Invalid op %d", _field[0]);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (_state != STATE_DONE && _remaining > _header.targetLength - _outputLength)
+    {
+        ESP_LOGE(TAG, "Delta exceeds the target size");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if ((_state == STATE_DIFF || _state == STATE_INSERT) && _remaining == 0)
+        _state = STATE_OP;
+
+    return ESP_OK;
+}
+
+esp_err_t DeltaDecoder::_writeDiff(const uint8_t *data, size_t length)
+{
+    esp_err_t err = esp_partition_read(_source, _sourceOffset, _sourceBuffer, length);
+    if (err != ESP_OK)
+        return err;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        _sourceBuffer[i] += data[i];
+    }
+
+    _sourceOffset += length;
+    return _output(_context, (const char *)_sourceBuffer, length);
+}
+
+esp_err_t DeltaDecoder::write(const char *data, size_t length)
+{
+    const uint8_t *in = (const uint8_t *)data;
+    esp_err_t err;
+
+    while (length > 0 && _state != STATE_DONE)
+    {
+        size_t len;
+
+        switch (_state)
+        {
+        case STATE_HEADER:
+            len = sizeof(_header) - _fieldLength;
+            if (len > length)
+                len = length;
+            memcpy((uint8_t *)&_header + _fieldLength, in, len);
+            _fieldLength += len;
+
+            if (_fieldLength == sizeof(_header))
+            {
+                _fieldLength = 0;
+                err = _verifySource();
+                if (err != ESP_OK)
+                    return err;
+                _state = STATE_OP;
+            }
+            break;
+
+        case STATE_OP:
+        {
+            if (_fieldLength == 0)
+            {
+                _field[_fieldLength++] = *in;
+                len = 1;
+            }
+            else
+            {
+                len = _opSize(_field[0]) - _fieldLength;
+                if (len > length)
+                    len = length;
+                memcpy(_field + _fieldLength, in, len);
+                _fieldLength += len;
+            }
+
+            if (_fieldLength >= _opSize(_field[0]))
+            {
+                _fieldLength = 0;
+                err = _parseOp();
+                if (err != ESP_OK)
+                    return err;
+            }
+            break;
+        }
+
+        case STATE_DIFF:
+            len = _remaining;
+            if (len > length)
+                len = length;
+            if (len > DELTA_SOURCE_BUFFER_SIZE)
+                len = DELTA_SOURCE_BUFFER_SIZE;
+
+            err = _writeDiff(in, len);
+            if (err != ESP_OK)
+                return err;
+
+            _remaining -= len;
+            _outputLength += len;
+            if (_remaining == 0)
+                _state = STATE_OP;
+            break;
+
+        case STATE_INSERT:
+            len = _remaining;
+            if (len > length)
+                len = length;
+
+            err = _output(_context, (const char *)in, len);
+            if (err != ESP_OK)
+                return err;
+
+            _remaining -= len;
+            _outputLength += len;
+            if (_remaining == 0)
+                _state = STATE_OP;
+            break;
+
+        default:
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        in += len;
+        length -= len;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t DeltaDecoder::end()
+{
+    if (_state != STATE_DONE)
+    {
+        ESP_LOGE(TAG, "Unexpected end of delta");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    return ESP_OK;
+}
+
+uint32_t DeltaDecoder::getOutputLength()
+{
+    return _outputLength;
+}
@@ -41,7 +41,31 @@ Ethernet::Ethernet(Settings *settings) : _settings(settings), _isConnected(false
     _netif_cfg = ESP_NETIF_DEFAULT_ETH();
     _eth_netif = esp_netif_new(&_netif_cfg);
 
-    if (settings->getUseDHCP())
+    _applyIPSettings();
+
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_eth_set_default_handlers(_eth_netif));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_event_handler_register(ETH_EVENT, ESP_EVENT_ANY_ID, &::_handleETHEvent, (void *)this));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_event_handler_register(IP_EVENT, IP_EVENT_ETH_GOT_IP, &::_handleIPEvent, (void *)this));
+
+    _phy_config = ETH_PHY_DEFAULT_CONFIG();
+    _phy_config.phy_addr = ETH_PHY_ADDR;
+    _phy_config.reset_gpio_num = ETH_POWER_PIN;
+    _phy = esp_eth_phy_new_lan8720(&_phy_config);
+
+    _mac_config = ETH_MAC_DEFAULT_CONFIG();
+    _mac_config.smi_mdc_gpio_num = ETH_MDC_PIN;
+    _mac_config.smi_mdio_gpio_num = ETH_MDIO_PIN;
+    _mac = esp_eth_mac_new_esp32(&_mac_config);
+
+    _eth_config = ETH_DEFAULT_CONFIG(_mac, _phy);
+    _eth_handle = NULL;
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_eth_driver_install(&_eth_config, &_eth_handle));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_attach(_eth_netif, esp_eth_new_netif_glue(_eth_handle)));
+}
+
+void Ethernet::_applyIPSettings()
+{
+    if (_settings->getUseDHCP())
     {
         ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcpc_start(_eth_netif));
     }
@@ -50,44 +74,25 @@ Ethernet::Ethernet(Settings *settings) : _settings(settings), _isConnected(false
         ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcpc_stop(_eth_netif));
 
         esp_netif_ip_info_t ipInfo;
-        ipInfo.ip.addr = settings->getLocalIP().addr;
-        ipInfo.netmask.addr = settings->getNetmask().addr;
-        ipInfo.gw.addr = settings->getGateway().addr;
+        ipInfo.ip.addr = _settings->getLocalIP().addr;
+        ipInfo.netmask.addr = _settings->getNetmask().addr;
+        ipInfo.gw.addr = _settings->getGateway().addr;
         ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_set_ip_info(_eth_netif, &ipInfo));
 
         esp_netif_dns_info_t dnsInfo;
         dnsInfo.ip.type = ESP_IPADDR_TYPE_V4;
-        dnsInfo.ip.u_addr.ip4.addr = settings->getDns1().addr;
+        dnsInfo.ip.u_addr.ip4.addr = _settings->getDns1().addr;
         if (dnsInfo.ip.u_addr.ip4.addr != IPADDR_ANY && dnsInfo.ip.u_addr.ip4.addr != IPADDR_NONE)
         {
             ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_set_dns_info(_eth_netif, ESP_NETIF_DNS_MAIN, &dnsInfo));
         }
 
-        dnsInfo.ip.u_addr.ip4.addr = settings->getDns2().addr;
+        dnsInfo.ip.u_addr.ip4.addr = _settings->getDns2().addr;
         if (dnsInfo.ip.u_addr.ip4.addr != IPADDR_ANY && dnsInfo.ip.u_addr.ip4.addr != IPADDR_NONE)
         {
             ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_set_dns_info(_eth_netif, ESP_NETIF_DNS_BACKUP, &dnsInfo));
         }
     }
-
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_eth_set_default_handlers(_eth_netif));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_event_handler_register(ETH_EVENT, ESP_EVENT_ANY_ID, &::_handleETHEvent, (void *)this));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_event_handler_register(IP_EVENT, IP_EVENT_ETH_GOT_IP, &::_handleIPEvent, (void *)this));
-
-    _phy_config = ETH_PHY_DEFAULT_CONFIG();
-    _phy_config.phy_addr = ETH_PHY_ADDR;
-    _phy_config.reset_gpio_num = ETH_POWER_PIN;
-    _phy = esp_eth_phy_new_lan8720(&_phy_config);
-
-    _mac_config = ETH_MAC_DEFAULT_CONFIG();
-    _mac_config.smi_mdc_gpio_num = ETH_MDC_PIN;
-    _mac_config.smi_mdio_gpio_num = ETH_MDIO_PIN;
-    _mac = esp_eth_mac_new_esp32(&_mac_config);
-
-    _eth_config = ETH_DEFAULT_CONFIG(_mac, _phy);
-    _eth_handle = NULL;
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_eth_driver_install(&_eth_config, &_eth_handle));
-    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_attach(_eth_netif, esp_eth_new_netif_glue(_eth_handle)));
 }
 
 void Ethernet::start()
@@ -100,6 +105,23 @@ void Ethernet::stop()
     ESP_ERROR_CHECK_WITHOUT_ABORT(esp_eth_stop(_eth_handle));
 }
 
+void Ethernet::reconfigure()
+{
+    // the link stays up, only the IP configuration is renewed
+    _isConnected = false;
+
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_set_hostname(_eth_netif, _settings->getHostname()));
+
+    // restart a running DHCP client, so the new hostname is announced
+    esp_netif_dhcpc_stop(_eth_netif);
+    _applyIPSettings();
+}
+
+bool Ethernet::isConnected()
+{
+    return _isConnected;
+}
+
 void Ethernet::getNetworkSettings(ip4_addr_t *ip, ip4_addr_t *netmask, ip4_addr_t *gateway, ip4_addr_t *dns1, ip4_addr_t *dns2)
 {
     if (_isConnected)
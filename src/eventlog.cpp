@@ -0,0 +1,192 @@
+/* 
+ *  eventlog.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+
+#include "eventlog.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "EventLog";
+
+static eventlog_record_t _records[EVENTLOG_CAPACITY];
+static eventlog_site_t *_sites[EVENTLOG_MAX_SITES];
+static uint16_t _siteCount = 0;
+static uint32_t _nextSeq = 0;
+static uint32_t _drainSeq = 0;
+static uint32_t _dropped = 0; // records suppressed by the rate limit or lost for lack of call site slots
+static portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t _tHandle = NULL;
+
+static const char _levelChars[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+
+void eventLogTask(void *parameter)
+{
+    eventlog_record_t record;
+    char message[160];
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for (;;)
+        {
+            portENTER_CRITICAL(&_lock);
+            if (_nextSeq - _drainSeq > EVENTLOG_CAPACITY)
+            {
+                // the ring wrapped before the console caught up
+                _drainSeq = _nextSeq - EVENTLOG_CAPACITY;
+            }
+            uint32_t seq = _drainSeq;
+            bool pending = seq != _nextSeq;
+            if (pending)
+            {
+                record = _records[seq % EVENTLOG_CAPACITY];
+                _drainSeq++;
+            }
+            portEXIT_CRITICAL(&_lock);
+
+            if (!pending)
+                break;
+
+            EventLog::format(&record, message, sizeof(message));
+            eventlog_site_t *site = _sites[record.site];
+            esp_log_write(site->level, site->tag, "%s\n", message);
+        }
+    }
+}
+
+void EventLog::start()
+{
+    if (_tHandle == NULL)
+    {
+        // lowest priority above idle, printing to the console must never delay the network tasks
+        xTaskCreate(eventLogTask, "EventLog_Drain", 3072, NULL, 1, &_tHandle);
+    }
+}
+
+void EventLog::stop()
+{
+    if (_tHandle != NULL)
+    {
+        vTaskDelete(_tHandle);
+        _tHandle = NULL;
+    }
+}
+
+void EventLog::log(eventlog_site_t *site, const uint32_t *args, size_t argc)
+{
+    uint32_t now = esp_log_timestamp();
+    bool stored = false;
+
+    portENTER_CRITICAL(&_lock);
+
+    if (site->index < 0)
+    {
+        if (_siteCount < EVENTLOG_MAX_SITES)
+        {
+            site->index = _siteCount;
+            _sites[_siteCount++] = site;
+        }
+    }
+
+    if (now - site->windowStart >= 1000)
+    {
+        site->windowStart = now;
+        site->count = 0;
+    }
+
+    if (site->index >= 0 && site->count < EVENTLOG_RATE_LIMIT)
+    {
+        site->count++;
+
+        eventlog_record_t *record = &_records[_nextSeq % EVENTLOG_CAPACITY];
+        record->timestamp = now;
+        record->site = site->index;
+        record->suppressed = site->suppressed;
+        memset(record->args, 0, sizeof(record->args));
+        memcpy(record->args, args, (argc < EVENTLOG_MAX_ARGS ? argc : EVENTLOG_MAX_ARGS) * sizeof(uint32_t));
+
+        site->suppressed = 0;
+        _nextSeq++;
+        stored = true;
+    }
+    else
+    {
+        if (site->suppressed < UINT16_MAX)
+            site->suppressed++;
+        _dropped++;
+    }
+
+    portEXIT_CRITICAL(&_lock);
+
+    if (stored && _tHandle != NULL)
+        xTaskNotifyGive(_tHandle);
+}
+
+uint32_t EventLog::getFirstSeq()
+{
+    portENTER_CRITICAL(&_lock);
+    uint32_t first = _nextSeq > EVENTLOG_CAPACITY ? _nextSeq - EVENTLOG_CAPACITY : 0;
+    portEXIT_CRITICAL(&_lock);
+    return first;
+}
+
+uint32_t EventLog::getNextSeq()
+{
+    return _nextSeq;
+}
+
+bool EventLog::read(uint32_t seq, eventlog_record_t *record)
+{
+    bool valid;
+
+    portENTER_CRITICAL(&_lock);
+    valid = seq < _nextSeq && _nextSeq - seq <= EVENTLOG_CAPACITY;
+    if (valid)
+        *record = _records[seq % EVENTLOG_CAPACITY];
+    portEXIT_CRITICAL(&_lock);
+
+    return valid;
+}
+
+int EventLog::format(const eventlog_record_t *record, char *buffer, size_t len)
+{
+    if (record->site >= _siteCount)
+        return snprintf(buffer, len, "? (%u) %s: invalid record", (unsigned int)record->timestamp, TAG);
+
+    eventlog_site_t *site = _sites[record->site];
+
+    int pos = snprintf(buffer, len, "%c (%u) %s: ", _levelChars[site->level], (unsigned int)record->timestamp, site->tag);
+    if (pos < 0 || (size_t)pos >= len)
+        return pos;
+
+    // unused arguments are ignored by the format string
+    pos += snprintf(buffer + pos, len - pos, site->format, record->args[0], record->args[1], record->args[2], record->args[3]);
+
+    if (record->suppressed > 0 && (size_t)pos < len)
+        pos += snprintf(buffer + pos, len - pos, " (%u similar suppressed)", (unsigned int)record->suppressed);
+
+    return pos;
+}
+
+uint32_t EventLog::getDroppedCount()
+{
+    return _dropped;
+}
@@ -21,14 +21,46 @@
 #include "pins.h"
 #include "esp_log.h"
 #include "string.h"
+#include <sys/param.h>
+#include "nmea.h"
+#include "calendar.h"
+#include "profiler.h"
+
+static const char *TAG = "GPS";
 
 void gpsSerialQueueHandlerTask(void *parameter)
 {
     ((GPS *)parameter)->_gpsSerialQueueHandler();
 }
 
+static volatile uint32_t _ppsInterruptCount = 0;
+static volatile uint32_t _ppsCpuTime = 0;
+
+static void IRAM_ATTR onPpsEdge(void *arg)
+{
+    int64_t edgeTime = esp_timer_get_time();
+    _ppsInterruptCount++;
+
+    BaseType_t xHigherPriorityTaskWokenByPost = pdFALSE;
+    xQueueSendFromISR((QueueHandle_t)arg, &edgeTime, &xHigherPriorityTaskWokenByPost);
+
+    _ppsCpuTime += (uint32_t)(esp_timer_get_time() - edgeTime);
+
+    if (xHigherPriorityTaskWokenByPost)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
 GPS::GPS(Settings *settings, SystemClock *clk) : _settings(settings), _clk(clk)
 {
+    using namespace std::placeholders;
+    _lineReader = new LineReader(std::bind(&GPS::_handleLine, this, _1, _2));
+}
+
+void GPS::start()
+{
+    // configured on every start, so a changed baudrate is applied and the shared DCF pin is only claimed when needed
     uart_config_t uart_config = {
         .baud_rate = _settings->getGpsBaudrate(),
         .data_bits = UART_DATA_8_BITS,
@@ -40,42 +72,100 @@ GPS::GPS(Settings *settings, SystemClock *clk) : _settings(settings), _clk(clk)
     uart_param_config(UART_NUM_2, &uart_config);
     uart_set_pin(UART_NUM_2, GPIO_NUM_0, DCF_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
 
-    using namespace std::placeholders;
-    _lineReader = new LineReader(std::bind(&GPS::_handleLine, this, _1, _2));
-}
+    uart_driver_install(UART_NUM_2, UART_FIFO_LEN * 4, 0, 20, &_uart_queue, 0);
 
-void GPS::start()
-{
-    uart_driver_install(UART_NUM_2, UART_FIFO_LEN * 2, 0, 20, &_uart_queue, 0);
+    // the rx full and timeout interrupts stay enabled, they move the data from the 128 byte fifo into the ring buffer,
+    // sentences are only read once their line terminator was detected
+    uart_enable_pattern_det_baud_intr(UART_NUM_2, '\n', 1, 9, 0, 0);
+    uart_pattern_queue_reset(UART_NUM_2, 20);
+
+    // owned by the instance, the task is deleted by stop() and can not free it itself
+    _buffer = (uint8_t *)malloc(UART_FIFO_LEN);
     xTaskCreate(gpsSerialQueueHandlerTask, "GPS_UART_QueueHandler", 4096, this, 15, &_tHandle);
+
+    int ppsPin = _settings->getGpsPpsPin();
+    if (ppsPin >= 0 && isValidGpsPpsPin(ppsPin))
+    {
+        _ppsPin = (gpio_num_t)ppsPin;
+        _ppsPairing.reset();
+        _pps_queue = xQueueCreate(4, sizeof(int64_t));
+
+        gpio_config_t io_conf;
+        io_conf.intr_type = GPIO_INTR_POSEDGE;
+        io_conf.mode = GPIO_MODE_INPUT;
+        io_conf.pin_bit_mask = 1ULL << _ppsPin;
+        io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+        io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
+        gpio_config(&io_conf);
+
+        gpio_install_isr_service(0);
+        gpio_isr_handler_add(_ppsPin, onPpsEdge, _pps_queue);
+        Profiler::registerIsr("pps", &_ppsInterruptCount, &_ppsCpuTime);
+
+        ESP_LOGI(TAG, "Using PPS input on GPIO %d", _ppsPin);
+    }
 }
 
 void GPS::stop()
 {
+    if (_ppsPin != GPIO_NUM_NC)
+    {
+        gpio_isr_handler_remove(_ppsPin);
+        vQueueDelete(_pps_queue);
+        _pps_queue = NULL;
+        _ppsPin = GPIO_NUM_NC;
+    }
+
     uart_driver_delete(UART_NUM_2);
     vTaskDelete(_tHandle);
+
+    free(_buffer);
+    _buffer = NULL;
 }
 
 void GPS::_gpsSerialQueueHandler()
 {
     uart_event_t event;
-    uint8_t *buffer = (uint8_t *)malloc(UART_FIFO_LEN);
+    uint8_t *buffer = _buffer;
 
     uart_flush_input(UART_NUM_2);
 
+    int pos, len;
+
     for (;;)
     {
         if (xQueueReceive(_uart_queue, (void *)&event, (portTickType)portMAX_DELAY))
         {
+            _countWakeup();
+
             switch (event.type)
             {
+            case UART_PATTERN_DET:
+                pos = uart_pattern_pop_pos(UART_NUM_2);
+                if (pos < 0)
+                {
+                    // pattern queue overflowed, positions are lost
+                    uart_flush_input(UART_NUM_2);
+                    _lineReader->Flush();
+                    break;
+                }
+
+                // read the complete sentence including the line terminator
+                for (pos++; pos > 0; pos -= len)
+                {
+                    len = uart_read_bytes(UART_NUM_2, buffer, MIN(pos, UART_FIFO_LEN), 0);
+                    if (len <= 0)
+                        break;
+                    _lineReader->Append(buffer, len);
+                }
+                break;
             case UART_DATA:
-                uart_read_bytes(UART_NUM_2, buffer, event.size, portMAX_DELAY);
-                _lineReader->Append(buffer, event.size);
+                // stays in the ring buffer until the pattern event of its line terminator
                 break;
             case UART_FIFO_OVF:
             case UART_BUFFER_FULL:
                 uart_flush_input(UART_NUM_2);
+                uart_pattern_queue_reset(UART_NUM_2, 20);
                 xQueueReset(_uart_queue);
                 _lineReader->Flush();
                 break;
@@ -90,76 +180,149 @@ void GPS::_gpsSerialQueueHandler()
         }
     }
 
-    free(buffer);
-    buffer = NULL;
     vTaskDelete(NULL);
 }
 
-bool parseRMCTime(unsigned char *buffer, uint16_t len, timeval *tv)
+void GPS::_countWakeup()
 {
-    int fieldIndex = 0;
-    int fieldStart = 0;
-
-    int fieldLength;
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - _wakeupWindowStart;
 
-    struct tm time = {};
-    time.tm_isdst = 0;
+    _wakeups++;
 
-    for (int i = 0; i < len; i++)
+    if (elapsed >= 1000000)
     {
-        if (buffer[i] == ',')
-        {
-            fieldLength = i - fieldStart;
+        _wakeupsPerSecond = _wakeups * 1000000LL / elapsed;
+        _wakeups = 0;
+        _wakeupWindowStart = now;
+    }
+}
 
-            if (fieldIndex == 1)
-            {
-                if (fieldLength != 9)
-                    return false;
+uint32_t GPS::getWakeupsPerSecond()
+{
+    // no wake ups at all during the last windows
+    if (esp_timer_get_time() - _wakeupWindowStart > 2000000)
+        return 0;
 
-                time.tm_sec = ((buffer[fieldStart + 4] - '0') * 10) + (buffer[fieldStart + 5] - '0');
-                time.tm_min = ((buffer[fieldStart + 2] - '0') * 10) + (buffer[fieldStart + 3] - '0');
-                time.tm_hour = ((buffer[fieldStart + 0] - '0') * 10) + (buffer[fieldStart + 1] - '0');
+    return _wakeupsPerSecond;
+}
 
-                tv->tv_usec = ((buffer[fieldStart + 4] - '7') * 100000) + ((buffer[fieldStart + 8] - '0') * 10000);
-            }
-            else if (fieldIndex == 9)
-            {
-                if (fieldLength != 6)
-                    return false;
+static bool toTimeval(int year, int month, int day, int hour, int minute, int second, int usec, timeval *tv)
+{
+    if (year < 2000 || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+        return false;
 
-                time.tm_year = ((buffer[fieldStart + 4] - '0') * 10) + (buffer[fieldStart + 5] - '0') + 100;
-                time.tm_mon = ((buffer[fieldStart + 2] - '0') * 10) + (buffer[fieldStart + 3] - '0') - 1;
-                time.tm_mday = ((buffer[fieldStart + 0] - '0') * 10) + (buffer[fieldStart + 1] - '0');
-            }
+    // NMEA times are UTC, so do not depend on the process time zone like mktime
+    tv->tv_sec = epochFromCivil(year, month, day, hour, minute, second);
+    tv->tv_usec = usec;
 
-            fieldIndex++;
-            fieldStart = i + 1;
-        }
-    }
+    return true;
+}
+
+// $--RMC,hhmmss.ss,A,llll.ll,a,yyyyy.yy,a,x.x,x.x,ddmmyy,x.x,a,m*hh
+static bool parseRMCTime(NmeaSentence *sentence, timeval *tv)
+{
+    int hour, minute, second, usec, day, month, year;
 
-    if (fieldIndex != 12)
+    if (!sentence->getTime(1, &hour, &minute, &second, &usec) || !sentence->getDate(9, &day, &month, &year))
         return false;
 
-    tv->tv_sec = mktime(&time);
+    return toTimeval(year, month, day, hour, minute, second, usec, tv);
+}
 
-    return true;
+// $--ZDA,hhmmss.ss,dd,mm,yyyy,zh,zm*hh
+static bool parseZDATime(NmeaSentence *sentence, timeval *tv)
+{
+    int hour, minute, second, usec, day, month, year;
+
+    if (!sentence->getTime(1, &hour, &minute, &second, &usec) || !sentence->getInt(2, &day) || !sentence->getInt(3, &month) || !sentence->getInt(4, &year))
+        return false;
+
+    if (day < 1 || day > 31 || month < 1 || month > 12 || year < 2000)
+        return false;
+
+    return toTimeval(year, month, day, hour, minute, second, usec, tv);
+}
+
+// the age of the sample can exceed a full second, carry it into tv_sec
+static void normalizeTimeval(timeval *tv)
+{
+    tv->tv_sec += tv->tv_usec / 1000000;
+    tv->tv_usec %= 1000000;
 }
 
 void GPS::_handleLine(unsigned char *buffer, uint16_t len)
 {
     uint64_t startTime = esp_timer_get_time();
-    if ((len > 6) && (strncmp((char *)buffer, "$GPRMC", 6) == 0))
+
+    if (_ppsPin != GPIO_NUM_NC)
     {
-        timeval tv;
-        if (parseRMCTime(buffer, len, &tv))
+        int64_t edgeTime;
+        while (xQueueReceive(_pps_queue, &edgeTime, 0) == pdTRUE)
         {
-            if (_nextSync < startTime)
-            {
-                _nextSync = startTime + 300 * 1000 * 1000; // every 5 minutes
+            _ppsPairing.addEdge(edgeTime);
+        }
+    }
 
-                tv.tv_usec += esp_timer_get_time() - startTime;
-                _clk->setTime(&tv);
-            }
+    bool isRMC = NmeaSentence::hasType(buffer, len, "RMC");
+    bool isZDA = NmeaSentence::hasType(buffer, len, "ZDA");
+    bool isGGA = NmeaSentence::hasType(buffer, len, "GGA");
+
+    // skip all other sentences without tokenizing them
+    if (!isRMC && !isZDA && !isGGA)
+        return;
+
+    NmeaSentence sentence;
+    if (!sentence.parse(buffer, len))
+    {
+        ESP_LOGD(TAG, "Ignoring invalid sentence");
+        return;
+    }
+
+    timeval tv;
+
+    if (isGGA)
+    {
+        // $--GGA,hhmmss.ss,llll.ll,a,yyyyy.yy,a,q,...: fix quality 0 is invalid
+        int quality;
+        _hasFix = sentence.getInt(6, &quality) && quality > 0;
+        return;
+    }
+    else if (isRMC)
+    {
+        _hasFix = sentence.getChar(2) == 'A';
+        if (!_hasFix || !parseRMCTime(&sentence, &tv))
+            return;
+    }
+    else
+    {
+        // ZDA has no status, so rely on the fix of the other sentences
+        if (!_hasFix || !parseZDATime(&sentence, &tv))
+            return;
+    }
+
+    if (_nextSync < startTime)
+    {
+        if (_ppsPin != GPIO_NUM_NC && _ppsPairing.isLocked())
+        {
+            // only the sentence of the full second belongs to the last pulse
+            int64_t edgeTime;
+            if (tv.tv_usec != 0 || !_ppsPairing.pair(startTime, &edgeTime))
+                return;
+
+            _nextSync = startTime + 60 * 1000 * 1000; // every minute
+
+            tv.tv_usec = esp_timer_get_time() - edgeTime;
+            normalizeTimeval(&tv);
+            _clk->setTime(&tv, CLOCK_SOURCE_PPS);
+        }
+        else
+        {
+            _nextSync = startTime + 300 * 1000 * 1000; // every 5 minutes
+
+            tv.tv_usec += esp_timer_get_time() - startTime;
+            normalizeTimeval(&tv);
+            _clk->setTime(&tv, CLOCK_SOURCE_GPS);
         }
     }
 }
@@ -0,0 +1,191 @@
+/* 
+ *  gzipdecoder.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include "gzipdecoder.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp32/rom/miniz.h"
+#include "esp32/rom/crc.h"
+
+static const char *TAG = "GzipDecoder";
+
+#define GZIP_FLAG_FHCRC 0x02
+#define GZIP_FLAG_FEXTRA 0x04
+#define GZIP_FLAG_FNAME 0x08
+#define GZIP_FLAG_FCOMMENT 0x10
+
+bool GzipDecoder::isGzip(const char *data, size_t length)
+{
+    return length >= 3 && (uint8_t)data[0] == 0x1f && (uint8_t)data[1] == 0x8b && data[2] == 8;
+}
+
+GzipDecoder::GzipDecoder(gzip_output_func_t output, void *context) : _inflator(NULL), _window(NULL), _windowOffset(0), _headerParsed(false), _finished(false), _trailerLength(0), _outputLength(0), _crc(0), _output(output), _context(context)
+{
+}
+
+GzipDecoder::~GzipDecoder()
+{
+    free(_inflator);
+    free(_window);
+}
+
+esp_err_t GzipDecoder::begin()
+{
+    _inflator = heap_caps_malloc(sizeof(tinfl_decompressor), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    _window = (uint8_t *)heap_caps_malloc(GZIP_WINDOW_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+    if (_inflator == NULL || _window == NULL)
+    {
+        ESP_LOGE(TAG, "Could not allocate decoder");
+        return ESP_ERR_NO_MEM;
+    }
+
+    tinfl_init((tinfl_decompressor *)_inflator);
+    return ESP_OK;
+}
+
+esp_err_t GzipDecoder::_parseHeader(const uint8_t **data, size_t *length)
+{
+    // the header is expected to be completely contained in the first block
+    const uint8_t *p = *data;
+    const uint8_t *end = p + *length;
+
+    if (!isGzip((const char *)p, *length) || *length < 10)
+        return ESP_ERR_INVALID_ARG;
+
+    uint8_t flags = p[3];
+    p += 10;
+
+    if (flags & GZIP_FLAG_FEXTRA)
+    {
+        if (end - p < 2)
+            return ESP_ERR_INVALID_SIZE;
+        p += 2 + (p[0] | (p[1] << 8));
+    }
+    if (flags & GZIP_FLAG_FNAME)
+    {
+        while (p < end && *p)
+            p++;
+        p++;
+    }
+    if (flags & GZIP_FLAG_FCOMMENT)
+    {
+        while (p < end && *p)
+            p++;
+        p++;
+    }
+    if (flags & GZIP_FLAG_FHCRC)
+    {
+        p += 2;
+    }
+
+    if (p > end)
+        return ESP_ERR_INVALID_SIZE;
+
+    *length -= p - *data;
+    *data = p;
+    return ESP_OK;
+}
+
+esp_err_t GzipDecoder::write(const char *data, size_t length)
+{
+    const uint8_t *in = (const uint8_t *)data;
+
+    if (!_headerParsed)
+    {
+        esp_err_t err = _parseHeader(&in, &length);
+        if (err != ESP_OK)
+            return err;
+        _headerParsed = true;
+    }
+
+    while (!_finished && length > 0)
+    {
+        size_t inSize = length;
+        size_t outSize = GZIP_WINDOW_SIZE - _windowOffset;
+
+        // the window is used as circular output buffer, so its total size must stay a power of two
+        tinfl_status status = tinfl_decompress((tinfl_decompressor *)_inflator, in, &inSize, _window, _window + _windowOffset, &outSize, TINFL_FLAG_HAS_MORE_INPUT);
+
+        in += inSize;
+        length -= inSize;
+
+        if (outSize > 0)
+        {
+            esp_err_t err = _output(_context, (const char *)_window + _windowOffset, outSize);
+            if (err != ESP_OK)
+                return err;
+
+            _outputLength += outSize;
+            _crc = crc32_le(_crc, _window + _windowOffset, outSize);
+            _windowOffset = (_windowOffset + outSize) & (GZIP_WINDOW_SIZE - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE)
+        {
+            ESP_LOGE(TAG, "Invalid deflate stream (%d)", status);
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        if (status == TINFL_STATUS_DONE)
+            _finished = true;
+    }
+
+    // CRC32 and size of the uncompressed data, anything behind is ignored
+    if (_finished && _trailerLength < sizeof(_trailer))
+    {
+        size_t len = length < sizeof(_trailer) - _trailerLength ? length : sizeof(_trailer) - _trailerLength;
+        memcpy(_trailer + _trailerLength, in, len);
+        _trailerLength += len;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t GzipDecoder::end()
+{
+    if (!_finished || _trailerLength < sizeof(_trailer))
+    {
+        ESP_LOGE(TAG, "Unexpected end of gzip stream");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t size = _trailer[4] | (_trailer[5] << 8) | (_trailer[6] << 16) | ((uint32_t)_trailer[7] << 24);
+    if (size != _outputLength)
+    {
+        ESP_LOGE(TAG, "Size mismatch, expected %u, got %u", size, _outputLength);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t crc = _trailer[0] | (_trailer[1] << 8) | (_trailer[2] << 16) | ((uint32_t)_trailer[3] << 24);
+    if (crc != _crc)
+    {
+        ESP_LOGE(TAG, "CRC mismatch, expected %08x, got %08x", crc, _crc);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    return ESP_OK;
+}
+
+uint32_t GzipDecoder::getOutputLength()
+{
+    return _outputLength;
+}
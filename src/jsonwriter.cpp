@@ -0,0 +1,281 @@
+/* 
+ *  jsonwriter.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include "jsonwriter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+
+static const char *TAG = "JsonWriter";
+
+ChunkedWriter::ChunkedWriter(httpd_req_t *req) : _req(req), _length(0), _result(ESP_OK)
+{
+}
+
+void ChunkedWriter::write(const char *data, size_t length)
+{
+    if (_length + length > sizeof(_buffer))
+    {
+        flush();
+
+        if (length > sizeof(_buffer))
+        {
+            if (_result == ESP_OK)
+                _result = httpd_resp_send_chunk(_req, data, length);
+            return;
+        }
+    }
+
+    memcpy(_buffer + _length, data, length);
+    _length += length;
+}
+
+void ChunkedWriter::write(const char *data)
+{
+    write(data, strlen(data));
+}
+
+void ChunkedWriter::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    size_t available = sizeof(_buffer) - _length;
+    int len = vsnprintf(_buffer + _length, available, format, args);
+    va_end(args);
+
+    if (len < 0)
+        return;
+
+    if ((size_t)len < available)
+    {
+        _length += len;
+        return;
+    }
+
+    // does not fit into the remaining buffer, send what we have and format again
+    flush();
+
+    char *data = _buffer;
+    if ((size_t)len >= sizeof(_buffer))
+    {
+        data = (char *)malloc(len + 1);
+        if (data == NULL)
+        {
+            ESP_LOGE(TAG, "Could not allocate %d bytes", len + 1);
+            _result = ESP_ERR_NO_MEM;
+            return;
+        }
+    }
+
+    va_start(args, format);
+    vsnprintf(data, len + 1, format, args);
+    va_end(args);
+
+    if (data == _buffer)
+    {
+        _length = len;
+    }
+    else
+    {
+        write(data, len);
+        free(data);
+    }
+}
+
+void ChunkedWriter::flush()
+{
+    if (_length > 0)
+    {
+        if (_result == ESP_OK)
+            _result = httpd_resp_send_chunk(_req, _buffer, _length);
+        _length = 0;
+    }
+}
+
+esp_err_t ChunkedWriter::end()
+{
+    flush();
+
+    if (_result == ESP_OK)
+        _result = httpd_resp_send_chunk(_req, NULL, 0);
+
+    return _result;
+}
+
+JsonWriter::JsonWriter(httpd_req_t *req) : ChunkedWriter(req), _hasItems(0), _depth(0)
+{
+}
+
+void JsonWriter::_beginItem(const char *name)
+{
+    uint32_t mask = 1UL << _depth;
+
+    if (_hasItems & mask)
+        write(",", 1);
+    _hasItems |= mask;
+
+    if (name != NULL)
+    {
+        _writeString(name);
+        write(":", 1);
+    }
+}
+
+void JsonWriter::_writeString(const char *value)
+{
+    write("\"", 1);
+
+    const char *start = value;
+    const char *p = value;
+
+    for (; *p; p++)
+    {
+        unsigned char c = *p;
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        write(start, p - start);
+        start = p + 1;
+
+        switch (c)
+        {
+        case '"':
+            write("\\\"", 2);
+            break;
+        case '\\':
+            write("\\\\", 2);
+            break;
+        case '\b':
+            write("\\b", 2);
+            break;
+        case '\f':
+            write("\\f", 2);
+            break;
+        case '\n':
+            write("\\n", 2);
+            break;
+        case '\r':
+            write("\\r", 2);
+            break;
+        case '\t':
+            write("\\t", 2);
+            break;
+        default:
+            printf("\\u%04x", c);
+            break;
+        }
+    }
+
+    write(start, p - start);
+    write("\"", 1);
+}
+
+void JsonWriter::beginObject(const char *name)
+{
+    _beginItem(name);
+    write("{", 1);
+
+    if (_depth < JSON_WRITER_MAX_DEPTH)
+        _depth++;
+    _hasItems &= ~(1UL << _depth);
+}
+
+void JsonWriter::endObject()
+{
+    if (_depth > 0)
+        _depth--;
+    write("}", 1);
+}
+
+void JsonWriter::beginArray(const char *name)
+{
+    _beginItem(name);
+    write("[", 1);
+
+    if (_depth < JSON_WRITER_MAX_DEPTH)
+        _depth++;
+    _hasItems &= ~(1UL << _depth);
+}
+
+void JsonWriter::endArray()
+{
+    if (_depth > 0)
+        _depth--;
+    write("]", 1);
+}
+
+void JsonWriter::addString(const char *name, const char *value)
+{
+    _beginItem(name);
+
+    if (value == NULL)
+    {
+        write("null", 4);
+    }
+    else
+    {
+        _writeString(value);
+    }
+}
+
+void JsonWriter::addNumber(const char *name, double value)
+{
+    _beginItem(name);
+
+    // same number format as cJSON
+    if (isnan(value) || isinf(value))
+    {
+        write("null", 4);
+    }
+    else if (value == (double)(int64_t)value && fabs(value) < 1e15)
+    {
+        printf("%lld", (long long)value);
+    }
+    else
+    {
+        printf("%1.15g", value);
+    }
+}
+
+void JsonWriter::addBool(const char *name, bool value)
+{
+    _beginItem(name);
+
+    if (value)
+    {
+        write("true", 4);
+    }
+    else
+    {
+        write("false", 5);
+    }
+}
+
+void JsonWriter::addNumberArray(const char *name, const float *values, int count)
+{
+    beginArray(name);
+    for (int i = 0; i < count; i++)
+    {
+        addNumber(NULL, values[i]);
+    }
+    endArray();
+}
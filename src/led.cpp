@@ -16,35 +16,80 @@
  *  limitations under the License.
  *  
  */
-
 #include "led.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
+
+#define LED_TICK_LENGTH 125000 // usec, resolution of the blink patterns
+#define LED_TICK_COUNT 24      // ticks of the longest pattern
 
-static uint8_t _blinkState = 0;
 static LED *_leds[MAX_LED_COUNT] = {0};
-static TaskHandle_t _switchTaskHandle = NULL;
+static esp_timer_handle_t _blinkTimer = NULL;
+static SemaphoreHandle_t _mutex = NULL;
+static int64_t _epoch = 0;
 static int _highDuty;
 
-void ledSwitcherTask(void *parameter)
+// statistics compared to updating every LED at every tick
+static uint32_t _wakeups = 0;
+static uint32_t _registerWrites = 0;
+static uint32_t _stateChanges = 0;
+
+static uint32_t currentTick()
 {
-    for (;;)
-    {
-        _blinkState = (_blinkState + 1) % 24;
+    return (esp_timer_get_time() - _epoch) / LED_TICK_LENGTH;
+}
 
-        for (uint8_t i = 0; i < MAX_LED_COUNT; i++)
+static int brightnessToDuty(int brightness)
+{
+    return brightness * (1 << LEDC_TIMER_11_BIT) / 100;
+}
+
+static uint8_t ledCount()
+{
+    uint8_t count = 0;
+    while (count < MAX_LED_COUNT && _leds[count] != 0)
+        count++;
+    return count;
+}
+
+// needs to be called with _mutex taken
+static void scheduleNextTransition(uint32_t tick)
+{
+    esp_timer_stop(_blinkTimer);
+
+    for (uint32_t next = tick + 1; next <= tick + LED_TICK_COUNT; next++)
+    {
+        for (uint8_t i = 0; i < MAX_LED_COUNT && _leds[i] != 0; i++)
         {
-            if (_leds[i] == 0)
+            if (_leds[i]->_isBlinking() && _leds[i]->_getPatternState(next) != _leds[i]->_getPatternState(next - 1))
             {
-                break;
+                // the transition may already be due if the caller was preempted since reading the tick
+                int64_t delay = _epoch + (int64_t)next * LED_TICK_LENGTH - esp_timer_get_time();
+                esp_timer_start_once(_blinkTimer, delay > 0 ? delay : 0);
+                return;
             }
-            _leds[i]->updatePinState();
         }
-        vTaskDelay(125 / portTICK_PERIOD_MS);
     }
 
-    vTaskDelete(NULL);
+    // nothing blinks, the timer stays stopped
+}
+
+static void onBlinkTimer(void *arg)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    _wakeups++;
+
+    uint32_t tick = currentTick();
+    for (uint8_t i = 0; i < MAX_LED_COUNT && _leds[i] != 0; i++)
+    {
+        _leds[i]->_updatePinState(tick);
+    }
+    scheduleNextTransition(tick);
+
+    xSemaphoreGive(_mutex);
 }
 
 void LED::start(Settings *settings)
@@ -57,27 +102,89 @@ void LED::start(Settings *settings)
         .clk_cfg = LEDC_AUTO_CLK,
     };
 
-    _highDuty = settings->getLEDBrightness() * (1 << ledc_timer.duty_resolution) / 100;
+    _highDuty = brightnessToDuty(settings->getLEDBrightness());
 
     ledc_timer_config(&ledc_timer);
 
-    if (!_switchTaskHandle)
+    if (!_blinkTimer)
     {
-        xTaskCreate(ledSwitcherTask, "LED_Switcher", 4096, NULL, 10, &_switchTaskHandle);
+        esp_timer_create_args_t timer_args = {
+            .callback = onBlinkTimer,
+            .arg = NULL,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "LED_Blink"};
+        esp_timer_create(&timer_args, &_blinkTimer);
+
+        _mutex = xSemaphoreCreateMutex();
+        _epoch = esp_timer_get_time();
     }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    for (uint8_t i = 0; i < MAX_LED_COUNT && _leds[i] != 0; i++)
+    {
+        _leds[i]->_pinState = -1;
+        _leds[i]->_updatePinState(0);
+    }
+    scheduleNextTransition(0);
+
+    xSemaphoreGive(_mutex);
 }
 
 void LED::stop()
 {
-    if (_switchTaskHandle)
+    if (_blinkTimer)
     {
-        vTaskDelete(_switchTaskHandle);
-        _switchTaskHandle = NULL;
+        esp_timer_stop(_blinkTimer);
+        esp_timer_delete(_blinkTimer);
+        _blinkTimer = NULL;
+
+        vSemaphoreDelete(_mutex);
+        _mutex = NULL;
     }
 }
 
+// re-applies the duty of every LED without restarting the blink patterns
+void LED::setBrightness(int brightness)
+{
+    if (!_mutex)
+        return;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    _highDuty = brightnessToDuty(brightness);
+
+    uint32_t tick = currentTick();
+    for (uint8_t i = 0; i < MAX_LED_COUNT && _leds[i] != 0; i++)
+    {
+        _leds[i]->_pinState = -1;
+        _leds[i]->_updatePinState(tick);
+    }
+    scheduleNextTransition(tick);
+
+    xSemaphoreGive(_mutex);
+}
+
+uint32_t LED::getAvoidedWakeups()
+{
+    if (!_blinkTimer)
+        return 0;
+
+    return currentTick() - _wakeups;
+}
+
+uint32_t LED::getAvoidedRegisterWrites()
+{
+    if (!_blinkTimer)
+        return 0;
+
+    return currentTick() * ledCount() + _stateChanges - _registerWrites;
+}
+
 LED::LED(gpio_num_t pin)
 {
+    _state = LED_STATE_OFF;
+
     _channel_conf = {
         .gpio_num = pin,
         .speed_mode = LEDC_HIGH_SPEED_MODE,
@@ -104,36 +211,68 @@ LED::LED(gpio_num_t pin)
 
 void LED::setState(led_state_t state)
 {
-    _state = state;
-    updatePinState();
+    if (!_mutex)
+    {
+        // not started yet, LED::start applies the state
+        _state = state;
+        return;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    _stateChanges++;
+
+    if (_state != state)
+    {
+        _state = state;
+
+        uint32_t tick = currentTick();
+        _updatePinState(tick);
+        scheduleNextTransition(tick);
+    }
+
+    xSemaphoreGive(_mutex);
 }
 
-void LED::_setPinState(bool enabled) {
+void LED::_setPinState(bool enabled)
+{
+    if (_pinState == enabled)
+        return;
+
+    _pinState = enabled;
+    _registerWrites++;
+
     ledc_set_duty(_channel_conf.speed_mode, _channel_conf.channel, enabled ? _highDuty : 0);
     ledc_update_duty(_channel_conf.speed_mode, _channel_conf.channel);
 }
 
-void LED::updatePinState()
+bool LED::_isBlinking()
 {
+    return _state != LED_STATE_OFF && _state != LED_STATE_ON;
+}
+
+bool LED::_getPatternState(uint32_t tick)
+{
+    uint8_t blinkState = tick % LED_TICK_COUNT;
+
     switch (_state)
     {
-    case LED_STATE_OFF:
-        _setPinState(false);
-        break;
     case LED_STATE_ON:
-        _setPinState(true);
-        break;
+        return true;
     case LED_STATE_BLINK:
-        _setPinState((_blinkState % 8) < 4);
-        break;
+        return (blinkState % 8) < 4;
     case LED_STATE_BLINK_INV:
-        _setPinState((_blinkState % 8) >= 4);
-        break;
+        return (blinkState % 8) >= 4;
     case LED_STATE_BLINK_FAST:
-        _setPinState((_blinkState % 2) == 0);
-        break;
+        return (blinkState % 2) == 0;
     case LED_STATE_BLINK_SLOW:
-        _setPinState(_blinkState < 12);
-        break;
+        return blinkState < 12;
+    default:
+        return false;
     }
-}
\ No newline at end of file
+}
+
+void LED::_updatePinState(uint32_t tick)
+{
+    _setPinState(_getPatternState(tick));
+}
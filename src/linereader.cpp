@@ -20,7 +20,7 @@
 #include "linereader.h"
 #include <stdint.h>
 
-LineReader::LineReader(std::function<void(unsigned char *buffer, uint16_t len)> processor) : _processor(processor), _buffer_pos(0)
+LineReader::LineReader(std::function<void(unsigned char *buffer, uint16_t len)> processor) : _processor(processor), _buffer_pos(0), _overflow(false)
 {
 }
 
@@ -32,13 +32,25 @@ void LineReader::Append(unsigned char chr)
         return;
 
     case '\n':
-        _buffer[_buffer_pos++] = 0;
-        _processor(_buffer, _buffer_pos);
+        if (!_overflow)
+        {
+            _buffer[_buffer_pos++] = 0;
+            _processor(_buffer, _buffer_pos);
+        }
         _buffer_pos = 0;
+        _overflow = false;
         break;
 
     default:
-        _buffer[_buffer_pos++] = chr;
+        // keep space for the terminating zero, oversized lines are dropped
+        if (_buffer_pos < sizeof(_buffer) - 1)
+        {
+            _buffer[_buffer_pos++] = chr;
+        }
+        else
+        {
+            _overflow = true;
+        }
         break;
     }
 }
@@ -55,4 +67,5 @@ void LineReader::Append(unsigned char *buffer, uint16_t len)
 void LineReader::Flush()
 {
     _buffer_pos = 0;
+    _overflow = false;
 }
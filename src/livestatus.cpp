@@ -0,0 +1,237 @@
+/* 
+ *  livestatus.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+
+#include "livestatus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "LiveStatus";
+
+typedef struct
+{
+    LiveStatus *liveStatus;
+    char *message;
+} live_status_work_t;
+
+void liveStatusSamplerTask(void *parameter)
+{
+    ((LiveStatus *)parameter)->_samplerTask();
+}
+
+static void liveStatusBroadcastWork(void *arg)
+{
+    live_status_work_t *work = (live_status_work_t *)arg;
+    work->liveStatus->_broadcast(work->message);
+    free(work->message);
+    free(work);
+}
+
+LiveStatus::LiveStatus(Settings *settings, SysInfo *sysInfo, RawUartUdpListener *rawUartUdpListener, SystemClock *clk) : _settings(settings), _sysInfo(sysInfo), _rawUartUdpListener(rawUartUdpListener), _clk(clk)
+{
+    _mutex = xSemaphoreCreateMutex();
+}
+
+void LiveStatus::start()
+{
+    xTaskCreate(liveStatusSamplerTask, "LiveStatus_Sampler", 3072, this, 3, &_tHandle);
+}
+
+void LiveStatus::stop()
+{
+    vTaskDelete(_tHandle);
+}
+
+uint8_t LiveStatus::getSubscriberCount()
+{
+    return _subscriberCount;
+}
+
+#define APPEND(...)                                           \
+    if ((size_t)pos < len)                                    \
+    {                                                         \
+        pos += snprintf(buffer + pos, len - pos, __VA_ARGS__); \
+    }
+
+#define DELTA(field, ...)                                              \
+    if (previous == NULL || status->field != previous->field)          \
+    {                                                                  \
+        APPEND("%s", pos > 1 ? "," : "");                              \
+        APPEND(__VA_ARGS__);                                           \
+    }
+
+int LiveStatus::formatDelta(const live_status_t *status, const live_status_t *previous, char *buffer, size_t len)
+{
+    int pos = 0;
+    APPEND("{");
+
+    DELTA(cpuUsage, "\"cpuUsage\":%d.%d", status->cpuUsage / 10, status->cpuUsage % 10);
+    DELTA(memoryUsage, "\"memoryUsage\":%d.%d", status->memoryUsage / 10, status->memoryUsage % 10);
+    if (previous == NULL || status->rawUartRemoteAddress != previous->rawUartRemoteAddress)
+    {
+        ip4_addr_t addr = {.addr = status->rawUartRemoteAddress};
+        APPEND("%s\"rawUartRemoteAddress\":\"%s\"", pos > 1 ? "," : "", addr.addr == IPADDR_ANY ? "" : ip4addr_ntoa(&addr));
+    }
+    DELTA(framesToRemote, "\"rawUartFramesToRemote\":%d.%d", status->framesToRemote / 10, status->framesToRemote % 10);
+    DELTA(framesFromRemote, "\"rawUartFramesFromRemote\":%d.%d", status->framesFromRemote / 10, status->framesFromRemote % 10);
+    DELTA(clockSource, "\"clockSource\":%d", status->clockSource);
+    DELTA(lastSyncTime, "\"lastSyncTime\":%lld", (long long)status->lastSyncTime);
+
+    // an empty object means nothing changed
+    if (pos == 1)
+        return 0;
+
+    APPEND("}");
+    return (size_t)pos < len ? pos : -1;
+}
+
+void LiveStatus::_sample(live_status_t *status)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - _lastSample;
+    _lastSample = now;
+
+    uint32_t framesToRemote = _rawUartUdpListener->getFramesToRemote();
+    uint32_t framesFromRemote = _rawUartUdpListener->getFramesFromRemote();
+
+    status->cpuUsage = (int)(_sysInfo->getCpuUsage() * 10 + 0.5);
+    status->memoryUsage = (int)(_sysInfo->getMemoryUsage() * 10 + 0.5);
+    status->rawUartRemoteAddress = _rawUartUdpListener->getConnectedRemoteAddress().addr;
+    status->framesToRemote = elapsed > 0 ? (int)((framesToRemote - _lastFramesToRemote) * 10000000LL / elapsed) : 0;
+    status->framesFromRemote = elapsed > 0 ? (int)((framesFromRemote - _lastFramesFromRemote) * 10000000LL / elapsed) : 0;
+    status->clockSource = _clk->getSyncSource();
+    status->lastSyncTime = _clk->getLastSyncTime().tv_sec;
+
+    _lastFramesToRemote = framesToRemote;
+    _lastFramesFromRemote = framesFromRemote;
+}
+
+void LiveStatus::_samplerTask()
+{
+    live_status_t status;
+    char message[LIVE_STATUS_MAX_MESSAGE];
+
+    for (;;)
+    {
+        // read on every cycle, so a changed setting applies without a restart
+        int interval = _settings->getLiveStatusInterval();
+        vTaskDelay(MAX(interval, LIVE_STATUS_MIN_INTERVAL) / portTICK_PERIOD_MS);
+
+        // one sample per interval, independent of the number of subscribers
+        _sample(&status);
+
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        int len = _subscriberCount > 0 ? formatDelta(&status, _hasStatus ? &_status : NULL, message, sizeof(message)) : 0;
+        _status = status;
+        _hasStatus = true;
+        httpd_handle_t server = _server;
+        xSemaphoreGive(_mutex);
+
+        if (len <= 0)
+            continue;
+
+        live_status_work_t *work = (live_status_work_t *)malloc(sizeof(live_status_work_t));
+        if (work == NULL)
+            continue;
+        work->liveStatus = this;
+        work->message = strndup(message, len);
+
+        // sockets are only written from the server task, slow clients can not block the sampler
+        if (work->message == NULL || httpd_queue_work(server, liveStatusBroadcastWork, work) != ESP_OK)
+        {
+            free(work->message);
+            free(work);
+        }
+    }
+}
+
+void LiveStatus::_broadcast(char *message)
+{
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.type = HTTPD_WS_TYPE_TEXT;
+    frame.payload = (uint8_t *)message;
+    frame.len = strlen(message);
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    for (int i = 0; i < _subscriberCount;)
+    {
+        int fd = _subscribers[i];
+
+        if (httpd_ws_get_fd_info(_server, fd) != HTTPD_WS_CLIENT_WEBSOCKET || httpd_ws_send_frame_async(_server, fd, &frame) != ESP_OK)
+        {
+            // closed or failed, the last subscriber takes the free slot
+            _subscribers[i] = _subscribers[--_subscriberCount];
+            continue;
+        }
+        i++;
+    }
+
+    xSemaphoreGive(_mutex);
+}
+
+esp_err_t LiveStatus::subscribe(httpd_req_t *req)
+{
+    int fd = httpd_req_to_sockfd(req);
+    char message[LIVE_STATUS_MAX_MESSAGE];
+    int len = 0;
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    _server = req->handle;
+
+    bool known = false;
+    for (int i = 0; i < _subscriberCount; i++)
+    {
+        if (_subscribers[i] == fd)
+            known = true;
+    }
+
+    if (!known)
+    {
+        if (_subscriberCount >= LIVE_STATUS_MAX_SUBSCRIBERS)
+        {
+            xSemaphoreGive(_mutex);
+            ESP_LOGW(TAG, "Too many subscribers");
+            return ESP_FAIL;
+        }
+        _subscribers[_subscriberCount++] = fd;
+    }
+
+    // new subscribers start with the full state, later messages only carry changes
+    if (_hasStatus)
+        len = formatDelta(&_status, NULL, message, sizeof(message));
+
+    xSemaphoreGive(_mutex);
+
+    if (len <= 0)
+        return ESP_OK;
+
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.type = HTTPD_WS_TYPE_TEXT;
+    frame.payload = (uint8_t *)message;
+    frame.len = len;
+    return httpd_ws_send_frame(req, &frame);
+}
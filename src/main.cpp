@@ -41,6 +41,10 @@
 #include "ntpserver.h"
 #include "esp_ota_ops.h"
 #include "updatecheck.h"
+#include "reconfigurator.h"
+#include "eventlog.h"
+#include "remotesyslog.h"
+#include "telemetry.h"
 
 static const char *TAG = "HB-RF-ETH";
 
@@ -62,8 +66,13 @@ void app_main()
     uart_param_config(UART_NUM_0, &uart_config);
     uart_set_pin(UART_NUM_0, GPIO_NUM_1, GPIO_NUM_3, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
 
+    EventLog::start();
+
     Settings settings;
 
+    RemoteSyslog syslog(&settings);
+    syslog.start();
+
     LED powerLED(LED_PWR_PIN);
     LED statusLED(LED_STATUS_PIN);
 
@@ -104,18 +113,13 @@ void app_main()
     NtpClient ntpClient(&settings, &clk);
     GPS gps(&settings, &clk);
 
-    switch (settings.getTimesource())
-    {
-    case TIMESOURCE_NTP:
+    // all enabled time sources run concurrently, the system clock selects the best one
+    if (settings.isTimesourceEnabled(TIMESOURCE_NTP))
         ntpClient.start();
-        break;
-    case TIMESOURCE_GPS:
+    if (settings.isTimesourceEnabled(TIMESOURCE_GPS))
         gps.start();
-        break;
-    case TIMESOURCE_DCF:
+    if (settings.isTimesourceEnabled(TIMESOURCE_DCF))
         dcf.start();
-        break;
-    }
 
     MDns mdns;
     mdns.start(&settings);
@@ -160,12 +164,19 @@ void app_main()
     RawUartUdpListener rawUartUdpLister(&radioModuleConnector);
     rawUartUdpLister.start();
 
+    Telemetry telemetry(&sysInfo, &rawUartUdpLister, &ntpServer, &clk);
+    telemetry.start();
+
     UpdateCheck updateCheck(&sysInfo, &statusLED);
     updateCheck.start();
 
-    WebUI webUI(&settings, &statusLED, &sysInfo, &updateCheck, &ethernet, &rawUartUdpLister, &radioModuleConnector, &radioModuleDetector);
+    WebUI webUI(&settings, &statusLED, &sysInfo, &updateCheck, &ethernet, &rawUartUdpLister, &radioModuleConnector, &radioModuleDetector, &gps, &dcf, &clk, &telemetry);
     webUI.start();
 
+    // apply saved settings at runtime instead of rebooting
+    Reconfigurator reconfigurator(&settings, &ethernet, &mdns, &ntpClient, &gps, &dcf, &syslog);
+    reconfigurator.start();
+
     powerLED.setState(LED_STATE_ON);
     statusLED.setState(LED_STATE_OFF);
 
@@ -0,0 +1,187 @@
+/* 
+ *  nmea.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include "nmea.h"
+#include <string.h>
+
+static inline bool isDigit(unsigned char chr)
+{
+    return chr >= '0' && chr <= '9';
+}
+
+static inline int hexValue(unsigned char chr)
+{
+    if (isDigit(chr))
+        return chr - '0';
+    if (chr >= 'A' && chr <= 'F')
+        return chr - 'A' + 10;
+    if (chr >= 'a' && chr <= 'f')
+        return chr - 'a' + 10;
+    return -1;
+}
+
+static bool parseDigits(const unsigned char *data, uint16_t len, int *value)
+{
+    int res = 0;
+
+    for (uint16_t i = 0; i < len; i++)
+    {
+        if (!isDigit(data[i]))
+            return false;
+        res = res * 10 + (data[i] - '0');
+    }
+
+    *value = res;
+    return true;
+}
+
+// "$GPRMC,...": talker id (GP, GN, GL, GA, BD, ...) is ignored, proprietary sentences never match
+bool NmeaSentence::hasType(const unsigned char *buffer, uint16_t len, const char *type)
+{
+    return len > 6 && buffer[0] == '$' && buffer[1] != 'P' && buffer[6] == ',' && memcmp(buffer + 3, type, 3) == 0;
+}
+
+bool NmeaSentence::parse(const unsigned char *buffer, uint16_t len)
+{
+    _fieldCount = 0;
+
+    while (len > 0 && (buffer[len - 1] == 0 || buffer[len - 1] == '\r' || buffer[len - 1] == '\n'))
+        len--;
+
+    // $<fields>*hh
+    if (len < 4 || buffer[0] != '$' || buffer[len - 3] != '*')
+        return false;
+
+    int checksumHigh = hexValue(buffer[len - 2]);
+    int checksumLow = hexValue(buffer[len - 1]);
+    if (checksumHigh < 0 || checksumLow < 0)
+        return false;
+
+    uint8_t checksum = 0;
+    uint16_t fieldStart = 1;
+    uint16_t end = len - 3;
+
+    for (uint16_t i = 1; i <= end; i++)
+    {
+        if (i == end || buffer[i] == ',')
+        {
+            if (_fieldCount == NMEA_MAX_FIELDS)
+            {
+                _fieldCount = 0;
+                return false;
+            }
+
+            _fields[_fieldCount].data = buffer + fieldStart;
+            _fields[_fieldCount].len = i - fieldStart;
+            _fieldCount++;
+            fieldStart = i + 1;
+        }
+        else if (buffer[i] == '*' || buffer[i] == '$')
+        {
+            _fieldCount = 0;
+            return false;
+        }
+
+        if (i < end)
+            checksum ^= buffer[i];
+    }
+
+    if (checksum != ((checksumHigh << 4) | checksumLow))
+    {
+        _fieldCount = 0;
+        return false;
+    }
+
+    return true;
+}
+
+bool NmeaSentence::isType(const char *type)
+{
+    return _fieldCount > 0 && _fields[0].len == 5 && _fields[0].data[0] != 'P' && memcmp(_fields[0].data + 2, type, 3) == 0;
+}
+
+uint8_t NmeaSentence::getFieldCount()
+{
+    return _fieldCount;
+}
+
+nmea_field_t NmeaSentence::getField(uint8_t index)
+{
+    if (index >= _fieldCount)
+    {
+        nmea_field_t empty = {.data = NULL, .len = 0};
+        return empty;
+    }
+
+    return _fields[index];
+}
+
+char NmeaSentence::getChar(uint8_t index)
+{
+    nmea_field_t field = getField(index);
+    return field.len == 1 ? (char)field.data[0] : 0;
+}
+
+bool NmeaSentence::getInt(uint8_t index, int *value)
+{
+    nmea_field_t field = getField(index);
+    return field.len > 0 && field.len < 10 && parseDigits(field.data, field.len, value);
+}
+
+// hhmmss[.s...]
+bool NmeaSentence::getTime(uint8_t index, int *hour, int *minute, int *second, int *usec)
+{
+    nmea_field_t field = getField(index);
+
+    if (field.len < 6 || (field.len > 6 && (field.data[6] != '.' || field.len > 13)))
+        return false;
+
+    if (!parseDigits(field.data, 2, hour) || !parseDigits(field.data + 2, 2, minute) || !parseDigits(field.data + 4, 2, second))
+        return false;
+
+    if (*hour > 23 || *minute > 59 || *second > 60)
+        return false;
+
+    int fraction = 0;
+    int digits = field.len > 7 ? field.len - 7 : 0;
+    if (!parseDigits(field.data + 7, digits, &fraction))
+        return false;
+
+    for (; digits < 6; digits++)
+        fraction *= 10;
+
+    *usec = fraction;
+    return true;
+}
+
+// ddmmyy
+bool NmeaSentence::getDate(uint8_t index, int *day, int *month, int *year)
+{
+    nmea_field_t field = getField(index);
+
+    if (field.len != 6)
+        return false;
+
+    if (!parseDigits(field.data, 2, day) || !parseDigits(field.data + 2, 2, month) || !parseDigits(field.data + 4, 2, year))
+        return false;
+
+    *year += 2000;
+
+    return *day >= 1 && *day <= 31 && *month >= 1 && *month <= 12;
+}
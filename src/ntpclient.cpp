@@ -23,9 +23,12 @@
 static Settings *_settings;
 static SystemClock *_clk;
 
-static void _time_sync_notification_cb(struct timeval *tv)
+// replaces the weak default of esp_sntp, which steps the clock itself before notifying,
+// so NTP only reaches the system clock through the time source selector
+void sntp_sync_time(struct timeval *tv)
 {
-    _clk->setTime(tv);
+    _clk->setTime(tv, CLOCK_SOURCE_NTP);
+    sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
 }
 
 NtpClient::NtpClient(Settings *settings, SystemClock *clk)
@@ -38,7 +41,6 @@ void NtpClient::start()
 {
     sntp_setoperatingmode(SNTP_OPMODE_POLL);
     sntp_setservername(0, _settings->getNtpServer());
-    sntp_set_time_sync_notification_cb(_time_sync_notification_cb);
     sntp_init();
 }
 
@@ -20,10 +20,33 @@
 #include "ntpserver.h"
 #include <string.h>
 #include "esp_log.h"
+#include "esp_sntp.h"
 #include "udphelper.h"
 
 static const char *TAG = "NtpServer";
 
+#define NTP_PRECISION -19             // 2^-19 sec, system time has a resolution of 1 usec
+#define NTP_PHI 15                    // frequency tolerance in ppm, see RFC 5905
+#define NTP_MAX_DISPERSION 16000000LL // 16 sec, see RFC 5905
+
+typedef struct
+{
+    uint8_t stratum;
+    char refId[4];
+    uint32_t rootDelay;      // usec
+    uint32_t rootDispersion; // usec
+} ntp_source_quality_t;
+
+// estimated error of the time sources at the moment of synchronization
+static const ntp_source_quality_t _sourceQuality[] = {
+    {.stratum = 16, .refId = {'I', 'N', 'I', 'T'}, .rootDelay = 1000000, .rootDispersion = 1000000}, // CLOCK_SOURCE_NONE
+    {.stratum = 15, .refId = {'L', 'O', 'C', 'L'}, .rootDelay = 0, .rootDispersion = 1000000},       // CLOCK_SOURCE_RTC, 1 sec resolution
+    {.stratum = 3, .refId = {0, 0, 0, 0}, .rootDelay = 20000, .rootDispersion = 20000},               // CLOCK_SOURCE_NTP, upstream is usually stratum 2
+    {.stratum = 1, .refId = {'D', 'C', 'F', 0}, .rootDelay = 0, .rootDispersion = 10000},             // CLOCK_SOURCE_DCF, depends on configured offset
+    {.stratum = 1, .refId = {'G', 'P', 'S', 0}, .rootDelay = 0, .rootDispersion = 20000},             // CLOCK_SOURCE_GPS, NMEA latency
+    {.stratum = 1, .refId = {'P', 'P', 'S', 0}, .rootDelay = 0, .rootDispersion = 100},               // CLOCK_SOURCE_PPS, ISR latency
+};
+
 void _ntp_udpQueueHandlerTask(void *parameter)
 {
     ((NtpServer *)parameter)->_udpQueueHandler();
@@ -55,8 +78,47 @@ inline tstamp convertToNtp(struct timeval *tv)
     return (unsigned long long)tv->tv_sec + (((unsigned long long)tv->tv_usec) << 32);
 }
 
+inline uint32_t convertToNtpShort(int64_t usec)
+{
+    return htonl((uint32_t)((usec << 16) / 1000000));
+}
+
+void NtpServer::fillSyncQuality(ntp_packet_t *ntp, struct timeval *lastSync)
+{
+    clock_source_t source = _clk->getSyncSource();
+    const ntp_source_quality_t *quality = &_sourceQuality[source];
+
+    ntp->stratum = quality->stratum;
+    ntp->precision = NTP_PRECISION;
+    memcpy(ntp->ref_id, quality->refId, sizeof(ntp->ref_id));
+
+    if (source == CLOCK_SOURCE_NTP)
+    {
+        const ip_addr_t *server = sntp_getserver(0);
+        if (server != NULL && IP_IS_V4(server))
+        {
+            memcpy(ntp->ref_id, &ip_2_ip4(server)->addr, sizeof(ntp->ref_id));
+        }
+    }
+
+    // dispersion grows with the time since the last synchronization (holdover)
+    struct timeval now = _clk->getTime();
+    int64_t age = (now.tv_sec - lastSync->tv_sec) * 1000000LL + (now.tv_usec - lastSync->tv_usec);
+    if (age < 0)
+        age = 0;
+
+    int64_t dispersion = quality->rootDispersion + _clk->getJitter() + age * NTP_PHI / 1000000;
+    if (dispersion > NTP_MAX_DISPERSION)
+        dispersion = NTP_MAX_DISPERSION;
+
+    ntp->delay = convertToNtpShort(quality->rootDelay);
+    ntp->dispersion = convertToNtpShort(dispersion);
+}
+
 void NtpServer::handlePacket(pbuf *pb, ip4_addr_t addr, uint16_t port)
 {
+    _requestCount++;
+
     struct timeval tv = _clk->getTime();
     tstamp recv = convertToNtp(&tv);
 
@@ -83,12 +145,8 @@ void NtpServer::handlePacket(pbuf *pb, ip4_addr_t addr, uint16_t port)
     resp_addr.u_addr.ip4 = addr;
 
     ntp.flags = 4 << 3 | 4; // version 4, mode server
-    ntp.stratum = 15;       // Prefer other ntp server over us
     ntp.poll = 8;
-    ntp.precision = 0;               // precision 2^0=1sec because of RTC values;
-    ntp.delay = htonl(1 << 16);      // 1sec
-    ntp.dispersion = htonl(1 << 16); // 1sec
-    memset(ntp.ref_id, 0, sizeof(ntp.ref_id));
+    fillSyncQuality(&ntp, &lastSync);
     ntp.orig_time = ntp.trns_time;
     ntp.recv_time = recv;
     ntp.ref_time = convertToNtp(&lastSync);
@@ -120,6 +178,11 @@ void NtpServer::stop()
     vTaskDelete(_tHandle);
 }
 
+uint32_t NtpServer::getRequestCount()
+{
+    return _requestCount;
+}
+
 void NtpServer::_udpQueueHandler()
 {
     udp_event_t *event = NULL;
@@ -0,0 +1,357 @@
+/* 
+ *  otapipeline.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include "otapipeline.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "OtaPipeline";
+
+#define END_OF_STREAM -1
+#define PROGRESS_LOG_INTERVAL (256 * 1024)
+
+void otaWriterTask(void *parameter)
+{
+    ((OtaPipeline *)parameter)->_writerTask();
+}
+
+static esp_err_t writeDecompressed(void *context, const char *data, size_t length)
+{
+    return ((OtaPipeline *)context)->_writeImage(data, length);
+}
+
+static esp_err_t writePatched(void *context, const char *data, size_t length)
+{
+    return ((OtaPipeline *)context)->_writeOta(data, length);
+}
+
+OtaPipeline::OtaPipeline(WebUIBundle *bundle) : _bundle(bundle), _freeQueue(NULL), _filledQueue(NULL), _done(NULL), _writerRunning(false), _result(ESP_OK), _started(false), _isWebUIBundle(false), _imageSize(0), _partition(NULL), _otaHandle(0), _decoder(NULL), _delta(NULL), _imageStarted(false), _written(0), _startTime(0), _endTime(0)
+{
+    memset(_buffers, 0, sizeof(_buffers));
+    mbedtls_md_init(&_sha);
+}
+
+OtaPipeline::~OtaPipeline()
+{
+    for (int i = 0; i < OTA_PIPELINE_BUFFER_COUNT; i++)
+    {
+        free(_buffers[i]);
+    }
+
+    if (_freeQueue)
+        vQueueDelete(_freeQueue);
+    if (_filledQueue)
+        vQueueDelete(_filledQueue);
+    if (_done)
+        vSemaphoreDelete(_done);
+
+    delete _decoder;
+    delete _delta;
+    mbedtls_md_free(&_sha);
+}
+
+esp_err_t OtaPipeline::begin(size_t imageSize)
+{
+    _imageSize = imageSize;
+
+    _freeQueue = xQueueCreate(OTA_PIPELINE_BUFFER_COUNT, sizeof(int));
+    _filledQueue = xQueueCreate(OTA_PIPELINE_BUFFER_COUNT + 1, sizeof(int));
+    _done = xSemaphoreCreateBinary();
+
+    if (!_freeQueue || !_filledQueue || !_done)
+        return ESP_ERR_NO_MEM;
+
+    for (int i = 0; i < OTA_PIPELINE_BUFFER_COUNT; i++)
+    {
+        _buffers[i] = (char *)malloc(OTA_PIPELINE_BUFFER_SIZE);
+        if (_buffers[i] == NULL)
+            return ESP_ERR_NO_MEM;
+        xQueueSend(_freeQueue, &i, 0);
+    }
+
+    if (mbedtls_md_setup(&_sha, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0) != 0 || mbedtls_md_starts(&_sha) != 0)
+        return ESP_FAIL;
+
+    _startTime = esp_timer_get_time();
+
+    if (xTaskCreate(otaWriterTask, "OTA_Writer", 4096, this, 5, NULL) != pdPASS)
+        return ESP_ERR_NO_MEM;
+    _writerRunning = true;
+
+    return ESP_OK;
+}
+
+char *OtaPipeline::getBuffer(size_t *size)
+{
+    int index;
+    xQueueReceive(_freeQueue, &index, portMAX_DELAY);
+
+    *size = OTA_PIPELINE_BUFFER_SIZE;
+    return _buffers[index];
+}
+
+esp_err_t OtaPipeline::commit(char *buffer, size_t length)
+{
+    for (int i = 0; i < OTA_PIPELINE_BUFFER_COUNT; i++)
+    {
+        if (_buffers[i] == buffer)
+        {
+            _lengths[i] = length;
+            xQueueSend(_filledQueue, &i, portMAX_DELAY);
+            break;
+        }
+    }
+
+    return _result;
+}
+
+void OtaPipeline::_writerTask()
+{
+    int index;
+    size_t nextLog = PROGRESS_LOG_INTERVAL;
+
+    while (xQueueReceive(_filledQueue, &index, portMAX_DELAY) == pdTRUE && index != END_OF_STREAM)
+    {
+        if (_result == ESP_OK)
+        {
+            _result = _write(_buffers[index], _lengths[index]);
+
+            if (_written >= nextLog)
+            {
+                int64_t elapsed = esp_timer_get_time() - _startTime;
+                ESP_LOGI(TAG, "%d kB written, %.2f MB/s", _written / 1024, elapsed > 0 ? _written / (float)elapsed : 0);
+                nextLog += PROGRESS_LOG_INTERVAL;
+            }
+        }
+
+        xQueueSend(_freeQueue, &index, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(_done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t OtaPipeline::_write(const char *data, size_t length)
+{
+    if (!_started)
+    {
+        _started = true;
+
+        uint32_t magic = 0;
+        if (length >= sizeof(magic))
+            memcpy(&magic, data, sizeof(magic));
+        _isWebUIBundle = (_bundle != NULL) && (magic == WEBUI_BUNDLE_MAGIC);
+
+        if (_isWebUIBundle)
+        {
+            ESP_LOGW(TAG, "Begin web UI update, File Size: %d", _imageSize);
+            esp_err_t err = _bundle->beginUpdate();
+            if (err != ESP_OK)
+                return err;
+        }
+        else
+        {
+            _partition = esp_ota_get_next_update_partition(NULL);
+            if (_partition == NULL)
+                return ESP_ERR_NOT_FOUND;
+
+            size_t otaSize = _imageSize > 0 ? _imageSize : OTA_SIZE_UNKNOWN;
+
+            if (GzipDecoder::isGzip(data, length))
+            {
+                ESP_LOGW(TAG, "Begin compressed OTA Update to partition %s, File Size: %d", _partition->label, _imageSize);
+
+                _decoder = new GzipDecoder(writeDecompressed, this);
+                esp_err_t err = _decoder->begin();
+                if (err != ESP_OK)
+                    return err;
+
+                // the decompressed size is not known before the end of the stream
+#ifdef OTA_WITH_SEQUENTIAL_WRITES
+                otaSize = OTA_WITH_SEQUENTIAL_WRITES;
+#else
+                otaSize = OTA_SIZE_UNKNOWN;
+#endif
+            }
+            else if (DeltaDecoder::isDelta(data, length))
+            {
+                ESP_LOGW(TAG, "Begin delta OTA Update to partition %s, File Size: %d", _partition->label, _imageSize);
+
+#ifdef OTA_WITH_SEQUENTIAL_WRITES
+                otaSize = OTA_WITH_SEQUENTIAL_WRITES;
+#else
+                otaSize = OTA_SIZE_UNKNOWN;
+#endif
+            }
+            else
+            {
+                ESP_LOGW(TAG, "Begin OTA Update to partition %s, File Size: %d", _partition->label, _imageSize);
+            }
+
+            // with a known size only the needed sectors are erased
+            esp_err_t err = esp_ota_begin(_partition, otaSize, &_otaHandle);
+            if (err != ESP_OK)
+                return err;
+        }
+    }
+
+    mbedtls_md_update(&_sha, (const unsigned char *)data, length);
+    _written += length;
+
+    if (_isWebUIBundle)
+        return _bundle->writeUpdate(data, length);
+
+    if (_decoder != NULL)
+        return _decoder->write(data, length);
+
+    return _writeImage(data, length);
+}
+
+esp_err_t OtaPipeline::_writeImage(const char *data, size_t length)
+{
+    if (!_imageStarted)
+    {
+        _imageStarted = true;
+
+        // a delta may also be compressed, so it is detected after decompression
+        if (DeltaDecoder::isDelta(data, length))
+        {
+            _delta = new DeltaDecoder(esp_ota_get_running_partition(), writePatched, this);
+            esp_err_t err = _delta->begin();
+            if (err != ESP_OK)
+                return err;
+        }
+    }
+
+    if (_delta != NULL)
+        return _delta->write(data, length);
+
+    return _writeOta(data, length);
+}
+
+esp_err_t OtaPipeline::_writeOta(const char *data, size_t length)
+{
+    return esp_ota_write(_otaHandle, data, length);
+}
+
+void OtaPipeline::_stopWriter()
+{
+    if (!_writerRunning)
+        return;
+    _writerRunning = false;
+
+    int index = END_OF_STREAM;
+    xQueueSend(_filledQueue, &index, portMAX_DELAY);
+    xSemaphoreTake(_done, portMAX_DELAY);
+
+    _endTime = esp_timer_get_time();
+}
+
+esp_err_t OtaPipeline::end(const uint8_t *expectedSha256)
+{
+    _stopWriter();
+
+    if (_result != ESP_OK)
+    {
+        abort();
+        return _result;
+    }
+
+    if (!_started)
+        return ESP_ERR_INVALID_SIZE;
+
+    uint8_t sha256[32];
+    mbedtls_md_finish(&_sha, sha256);
+
+    if (expectedSha256 != NULL && memcmp(sha256, expectedSha256, sizeof(sha256)) != 0)
+    {
+        ESP_LOGE(TAG, "SHA-256 of the update does not match");
+        abort();
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    ESP_LOGI(TAG, "%d kB written with %.2f MB/s", _written / 1024, getThroughput());
+
+    if (_isWebUIBundle)
+        return _bundle->endUpdate();
+
+    if (_decoder != NULL)
+    {
+        esp_err_t err = _decoder->end();
+        if (err != ESP_OK)
+        {
+            abort();
+            return err;
+        }
+
+        ESP_LOGI(TAG, "Decompressed to %u kB", _decoder->getOutputLength() / 1024);
+    }
+
+    if (_delta != NULL)
+    {
+        esp_err_t err = _delta->end();
+        if (err != ESP_OK)
+        {
+            abort();
+            return err;
+        }
+
+        ESP_LOGI(TAG, "Delta applied, image size %u kB", _delta->getOutputLength() / 1024);
+    }
+
+    esp_err_t err = esp_ota_end(_otaHandle);
+    _otaHandle = 0;
+    if (err != ESP_OK)
+        return err;
+
+    return esp_ota_set_boot_partition(_partition);
+}
+
+void OtaPipeline::abort()
+{
+    _stopWriter();
+
+    if (_started && !_isWebUIBundle && _otaHandle != 0)
+    {
+        // releases the handle, the incomplete image is never marked bootable
+        esp_ota_end(_otaHandle);
+        _otaHandle = 0;
+    }
+}
+
+bool OtaPipeline::isWebUIBundle()
+{
+    return _isWebUIBundle;
+}
+
+size_t OtaPipeline::getWritten()
+{
+    return _written;
+}
+
+float OtaPipeline::getThroughput()
+{
+    int64_t end = _endTime ? _endTime : esp_timer_get_time();
+    int64_t elapsed = end - _startTime;
+
+    // bytes per usec equals MB/s
+    return elapsed > 0 ? _written / (float)elapsed : 0;
+}
@@ -0,0 +1,77 @@
+/* 
+ *  ppspairing.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include "ppspairing.h"
+
+#define PPS_INTERVAL 1000000LL
+#define PPS_TOLERANCE 500LL // usec, far beyond any crystal tolerance of a GPS receiver
+
+PpsPairing::PpsPairing()
+{
+    reset();
+}
+
+void PpsPairing::reset()
+{
+    _lastEdge = 0;
+    _validEdges = 0;
+}
+
+void PpsPairing::addEdge(int64_t edgeTime)
+{
+    int64_t interval = edgeTime - _lastEdge;
+
+    if (_validEdges > 0 && interval < PPS_INTERVAL - PPS_TOLERANCE)
+    {
+        // glitch, the next real edge is still expected one second after the last one
+        return;
+    }
+
+    if (_validEdges > 0 && interval <= PPS_INTERVAL + PPS_TOLERANCE)
+    {
+        _validEdges++;
+    }
+    else
+    {
+        // first edge or missing pulses, start over
+        _validEdges = 1;
+    }
+
+    _lastEdge = edgeTime;
+}
+
+bool PpsPairing::isLocked()
+{
+    // at least one verified interval is needed to trust the edges
+    return _validEdges >= 2;
+}
+
+bool PpsPairing::pair(int64_t sentenceTime, int64_t *edgeTime)
+{
+    if (!isLocked())
+        return false;
+
+    // the sentence is sent after the pulse which marks the begin of its second
+    int64_t delay = sentenceTime - _lastEdge;
+    if (delay < 0 || delay >= PPS_INTERVAL - PPS_TOLERANCE)
+        return false;
+
+    *edgeTime = _lastEdge;
+    return true;
+}
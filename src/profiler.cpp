@@ -0,0 +1,220 @@
+/* 
+ *  profiler.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include "profiler.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "Profiler";
+
+#define PROFILER_SAMPLE_INTERVAL 1000 // msec
+
+// smoothing factors of the moving averages for a sample every second
+static const float _windowFactors[PROFILER_WINDOW_COUNT] = {1.0f, 1.0f / 60, 1.0f / 900};
+
+const char *Profiler::windowNames[PROFILER_WINDOW_COUNT] = {"1s", "1m", "15m"};
+
+static profiler_isr_t _isrs[PROFILER_MAX_ISRS];
+static uint8_t _isrCount = 0;
+
+static profiler_task_t _scratch[PROFILER_MAX_TASKS];
+
+static void updateAverages(float *averages, float value)
+{
+    for (int i = 0; i < PROFILER_WINDOW_COUNT; i++)
+    {
+        averages[i] += (value - averages[i]) * _windowFactors[i];
+    }
+}
+
+void profilerTask(void *parameter)
+{
+    ((Profiler *)parameter)->_sample();
+}
+
+Profiler::Profiler()
+{
+    memset(_coreLoad, 0, sizeof(_coreLoad));
+    _mutex = xSemaphoreCreateMutex();
+}
+
+void Profiler::start()
+{
+    _taskStatus = (TaskStatus_t *)malloc(PROFILER_MAX_TASKS * sizeof(TaskStatus_t));
+    xTaskCreate(profilerTask, "Profiler", 4096, this, 3, NULL);
+}
+
+void Profiler::registerIsr(const char *name, volatile uint32_t *count, volatile uint32_t *time)
+{
+    for (uint8_t i = 0; i < _isrCount; i++)
+    {
+        if (_isrs[i].count == count)
+            return;
+    }
+
+    if (_isrCount >= PROFILER_MAX_ISRS)
+        return;
+
+    profiler_isr_t *isr = &_isrs[_isrCount];
+    memset(isr, 0, sizeof(profiler_isr_t));
+    isr->name = name;
+    isr->count = count;
+    isr->time = time;
+    isr->lastCount = *count;
+    isr->lastTime = *time;
+
+    _isrCount++;
+}
+
+void Profiler::_sample()
+{
+    int64_t lastSample = esp_timer_get_time();
+
+    for (;;)
+    {
+        vTaskDelay(PROFILER_SAMPLE_INTERVAL / portTICK_PERIOD_MS);
+
+        int64_t now = esp_timer_get_time();
+        uint32_t elapsed = now - lastSample;
+        lastSample = now;
+
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+
+        uint32_t totalRunTime;
+        UBaseType_t taskCount = uxTaskGetSystemState(_taskStatus, PROFILER_MAX_TASKS, &totalRunTime);
+
+        if (taskCount == 0)
+        {
+            ESP_LOGW(TAG, "More than %d tasks, cannot profile", PROFILER_MAX_TASKS);
+        }
+        else
+        {
+            _sampleTasks(taskCount, totalRunTime);
+        }
+
+        _sampleIsrs(elapsed);
+
+        xSemaphoreGive(_mutex);
+    }
+
+    vTaskDelete(NULL);
+}
+
+void Profiler::_sampleTasks(UBaseType_t taskCount, uint32_t totalRunTime)
+{
+    uint32_t totalDelta = totalRunTime - _lastTotalRunTime;
+    bool hasBaseline = _lastTotalRunTime != 0;
+    _lastTotalRunTime = totalRunTime;
+
+    uint8_t count = 0;
+
+    for (UBaseType_t i = 0; i < taskCount; i++)
+    {
+        TaskStatus_t *status = &_taskStatus[i];
+
+        // keep the history of tasks which were already known
+        profiler_task_t *task = &_scratch[count++];
+        memset(task, 0, sizeof(profiler_task_t));
+        for (uint8_t j = 0; j < _taskCount; j++)
+        {
+            if (_tasks[j].handle == status->xHandle)
+            {
+                *task = _tasks[j];
+                break;
+            }
+        }
+
+        bool isNew = task->handle == NULL;
+        task->handle = status->xHandle;
+        strncpy(task->name, status->pcTaskName, sizeof(task->name) - 1);
+        task->core = status->xCoreID == tskNO_AFFINITY ? -1 : status->xCoreID;
+        task->priority = status->uxCurrentPriority;
+        task->stackHighWaterMark = status->usStackHighWaterMark;
+
+        if (!isNew && hasBaseline && totalDelta > 0)
+        {
+            updateAverages(task->load, (status->ulRunTimeCounter - task->lastRunTime) * 100.0f / totalDelta);
+        }
+        task->lastRunTime = status->ulRunTimeCounter;
+    }
+
+    memcpy(_tasks, _scratch, count * sizeof(profiler_task_t));
+    _taskCount = count;
+
+    // the load of a core is everything but its idle task
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        TaskHandle_t idleTask = xTaskGetIdleTaskHandleForCPU(core);
+
+        for (uint8_t i = 0; i < _taskCount; i++)
+        {
+            if (_tasks[i].handle == idleTask)
+            {
+                for (int w = 0; w < PROFILER_WINDOW_COUNT; w++)
+                {
+                    _coreLoad[core][w] = 100.0f - _tasks[i].load[w];
+                }
+                break;
+            }
+        }
+    }
+}
+
+void Profiler::_sampleIsrs(uint32_t elapsed)
+{
+    for (uint8_t i = 0; i < _isrCount; i++)
+    {
+        profiler_isr_t *isr = &_isrs[i];
+
+        uint32_t count = *isr->count;
+        uint32_t time = *isr->time;
+
+        updateAverages(isr->rate, (count - isr->lastCount) * 1000000.0f / elapsed);
+        updateAverages(isr->load, (time - isr->lastTime) * 100.0f / elapsed);
+
+        isr->lastCount = count;
+        isr->lastTime = time;
+    }
+}
+
+uint8_t Profiler::getTasks(profiler_task_t *tasks, uint8_t maxCount)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    uint8_t count = _taskCount < maxCount ? _taskCount : maxCount;
+    memcpy(tasks, _tasks, count * sizeof(profiler_task_t));
+    xSemaphoreGive(_mutex);
+
+    return count;
+}
+
+uint8_t Profiler::getIsrs(profiler_isr_t *isrs, uint8_t maxCount)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    uint8_t count = _isrCount < maxCount ? _isrCount : maxCount;
+    memcpy(isrs, _isrs, count * sizeof(profiler_isr_t));
+    xSemaphoreGive(_mutex);
+
+    return count;
+}
+
+float Profiler::getCoreLoad(int core, int window)
+{
+    return _coreLoad[core][window];
+}
@@ -20,6 +20,7 @@
 #include "rawuartudplistener.h"
 #include "hmframe.h"
 #include "esp_log.h"
+#include "eventlog.h"
 #include <string.h>
 #include "udphelper.h"
 
@@ -51,6 +52,8 @@ RawUartUdpListener::RawUartUdpListener(RadioModuleConnector *radioModuleConnecto
     atomic_init(&_remoteAddress, 0u);
     atomic_init(&_counter, 0);
     atomic_init(&_endpointConnectionIdentifier, 1);
+    atomic_init(&_framesToRemote, 0u);
+    atomic_init(&_framesFromRemote, 0u);
 }
 
 void RawUartUdpListener::handlePacket(pbuf *pb, ip4_addr_t addr, uint16_t port)
@@ -61,19 +64,19 @@ void RawUartUdpListener::handlePacket(pbuf *pb, ip4_addr_t addr, uint16_t port)
 
     if (length < 4)
     {
-        ESP_LOGE(TAG, "Received invalid raw-uart packet, length %d", length);
+        EVENTLOG_E(TAG, "Received invalid raw-uart packet, length %d", length);
         return;
     }
 
     if (data[0] != 0 && (addr.addr != atomic_load(&_remoteAddress) || port != atomic_load(&_remotePort)))
     {
-        ESP_LOGE(TAG, "Received raw-uart packet from invalid address.");
+        EVENTLOG_E(TAG, "Received raw-uart packet from invalid address.");
         return;
     }
 
     if (*((uint16_t *)(data + length - 2)) != htons(HMFrame::crc(data, length - 2)))
     {
-        ESP_LOGE(TAG, "Received raw-uart packet with invalid crc.");
+        EVENTLOG_E(TAG, "Received raw-uart packet with invalid crc.");
         return;
     }
 
@@ -105,7 +108,7 @@ void RawUartUdpListener::handlePacket(pbuf *pb, ip4_addr_t addr, uint16_t port)
             }
             else if (data[3] != (endpointConnectionIdentifier & 0xff))
             {
-                ESP_LOGE(TAG, "Received raw-uart reconnect packet with invalid endpoint identifier %d, should be %d", data[3], endpointConnectionIdentifier);
+                EVENTLOG_E(TAG, "Received raw-uart reconnect packet with invalid endpoint identifier %d, should be %d", data[3], endpointConnectionIdentifier);
                 return;
             }
 
@@ -119,7 +122,7 @@ void RawUartUdpListener::handlePacket(pbuf *pb, ip4_addr_t addr, uint16_t port)
             sendMessage(0, response_buffer, 3);
         }
         else {
-            ESP_LOGE(TAG, "Received invalid raw-uart connect packet, length %d", length);
+            EVENTLOG_E(TAG, "Received invalid raw-uart connect packet, length %d", length);
             return;
         }
         break;
@@ -137,7 +140,7 @@ void RawUartUdpListener::handlePacket(pbuf *pb, ip4_addr_t addr, uint16_t port)
     case 3: // LED
         if (length != 5)
         {
-            ESP_LOGE(TAG, "Received invalid raw-uart LED packet, length %d", length);
+            EVENTLOG_E(TAG, "Received invalid raw-uart LED packet, length %d", length);
             return;
         }
 
@@ -147,7 +150,7 @@ void RawUartUdpListener::handlePacket(pbuf *pb, ip4_addr_t addr, uint16_t port)
     case 4: // Reset
         if (length != 4)
         {
-            ESP_LOGE(TAG, "Received invalid raw-uart reset packet, length %d", length);
+            EVENTLOG_E(TAG, "Received invalid raw-uart reset packet, length %d", length);
             return;
         }
 
@@ -157,7 +160,7 @@ void RawUartUdpListener::handlePacket(pbuf *pb, ip4_addr_t addr, uint16_t port)
     case 5: // Start connection
         if (length != 4)
         {
-            ESP_LOGE(TAG, "Received invalid raw-uart startconn packet, length %d", length);
+            EVENTLOG_E(TAG, "Received invalid raw-uart startconn packet, length %d", length);
             return;
         }
 
@@ -167,7 +170,7 @@ void RawUartUdpListener::handlePacket(pbuf *pb, ip4_addr_t addr, uint16_t port)
     case 6: // End connection
         if (length != 4)
         {
-            ESP_LOGE(TAG, "Received invalid raw-uart endconn packet, length %d", length);
+            EVENTLOG_E(TAG, "Received invalid raw-uart endconn packet, length %d", length);
             return;
         }
 
@@ -177,15 +180,16 @@ void RawUartUdpListener::handlePacket(pbuf *pb, ip4_addr_t addr, uint16_t port)
     case 7: // Frame
         if (length < 5)
         {
-            ESP_LOGE(TAG, "Received invalid raw-uart frame packet, length %d", length);
+            EVENTLOG_E(TAG, "Received invalid raw-uart frame packet, length %d", length);
             return;
         }
 
         _radioModuleConnector->sendFrame(&data[2], length - 4);
+        atomic_fetch_add(&_framesFromRemote, 1u);
         break;
 
     default:
-        ESP_LOGE(TAG, "Received invalid raw-uart packet with unknown type %d", data[0]);
+        EVENTLOG_E(TAG, "Received invalid raw-uart packet with unknown type %d", data[0]);
         break;
     }
 }
@@ -206,6 +210,16 @@ ip4_addr_t RawUartUdpListener::getConnectedRemoteAddress()
     }
 }
 
+uint32_t RawUartUdpListener::getFramesToRemote()
+{
+    return atomic_load(&_framesToRemote);
+}
+
+uint32_t RawUartUdpListener::getFramesFromRemote()
+{
+    return atomic_load(&_framesFromRemote);
+}
+
 void RawUartUdpListener::sendMessage(unsigned char command, unsigned char *buffer, size_t len)
 {
     uint16_t port = atomic_load(&_remotePort);
@@ -240,11 +254,12 @@ void RawUartUdpListener::handleFrame(unsigned char *buffer, uint16_t len)
 
     if (len > (1500 - 28 - 4))
     {
-        ESP_LOGE(TAG, "Received oversized frame from radio module, length %d", len);
+        EVENTLOG_E(TAG, "Received oversized frame from radio module, length %d", len);
         return;
     }
 
     sendMessage(7, buffer, len);
+    atomic_fetch_add(&_framesToRemote, 1u);
 }
 
 void RawUartUdpListener::start()
@@ -0,0 +1,203 @@
+/* 
+ *  reconfigurator.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+
+#include "reconfigurator.h"
+#include "led.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#define NETWORK_SETTINGS (SETTING_HOSTNAME | SETTING_USE_DHCP | SETTING_LOCAL_IP | SETTING_NETMASK | SETTING_GATEWAY | SETTING_DNS1 | SETTING_DNS2)
+#define NTP_SETTINGS (SETTING_TIMESOURCES | SETTING_NTP_SERVER)
+#define GPS_SETTINGS (SETTING_TIMESOURCES | SETTING_GPS_BAUDRATE | SETTING_GPS_PPS_PIN)
+#define DCF_SETTINGS (SETTING_TIMESOURCES | SETTING_DCF_CALIBRATION)
+
+#define NETWORK_TIMEOUT_MS 30000
+
+static const char *TAG = "Reconfigurator";
+
+const char *Reconfigurator::kindNames[RECONFIGURE_COUNT] = {"network", "mdns", "ntp", "gps", "dcf", "led"};
+
+static int64_t _lastOutage[RECONFIGURE_COUNT] = {-1, -1, -1, -1, -1, -1};
+
+void _handleSettingsChanges(void *context, uint32_t changes)
+{
+    ((Reconfigurator *)context)->_handleChanges(changes);
+}
+
+void reconfiguratorTask(void *parameter)
+{
+    ((Reconfigurator *)parameter)->_reconfiguratorTask();
+}
+
+Reconfigurator::Reconfigurator(Settings *settings, Ethernet *ethernet, MDns *mdns, NtpClient *ntpClient, GPS *gps, DCF *dcf, RemoteSyslog *syslog) : _settings(settings), _ethernet(ethernet), _mdns(mdns), _ntpClient(ntpClient), _gps(gps), _dcf(dcf), _syslog(syslog)
+{
+    // main starts all enabled time sources before the reconfigurator takes over
+    _ntpRunning = settings->isTimesourceEnabled(TIMESOURCE_NTP);
+    _gpsRunning = settings->isTimesourceEnabled(TIMESOURCE_GPS);
+    _dcfRunning = settings->isTimesourceEnabled(TIMESOURCE_DCF);
+}
+
+void Reconfigurator::start()
+{
+    _queue = xQueueCreate(4, sizeof(uint32_t));
+    xTaskCreate(reconfiguratorTask, "Reconfigurator", 4096, this, 5, &_tHandle);
+    _settings->setChangeHandler(_handleSettingsChanges, this);
+}
+
+void Reconfigurator::stop()
+{
+    _settings->setChangeHandler(NULL, NULL);
+    vTaskDelete(_tHandle);
+    vQueueDelete(_queue);
+}
+
+int64_t Reconfigurator::getLastOutage(reconfigure_kind_t kind)
+{
+    return _lastOutage[kind];
+}
+
+void Reconfigurator::_handleChanges(uint32_t changes)
+{
+    // called from the task saving the settings, never block it
+    if (xQueueSend(_queue, &changes, 0) != pdTRUE)
+        ESP_LOGW(TAG, "Queue full, dropped changes 0x%04x", changes);
+}
+
+void Reconfigurator::_reconfiguratorTask()
+{
+    uint32_t changes;
+
+    for (;;)
+    {
+        if (xQueueReceive(_queue, &changes, portMAX_DELAY) == pdTRUE)
+        {
+            // merge changes saved in quick succession into one restart per subsystem
+            uint32_t more;
+            while (xQueueReceive(_queue, &more, 0) == pdTRUE)
+                changes |= more;
+
+            _apply(changes);
+        }
+    }
+}
+
+void Reconfigurator::_recordOutage(reconfigure_kind_t kind, int64_t started)
+{
+    _lastOutage[kind] = esp_timer_get_time() - started;
+    ESP_LOGI(TAG, "Reconfigured %s, outage %lld usec", kindNames[kind], _lastOutage[kind]);
+}
+
+void Reconfigurator::_apply(uint32_t changes)
+{
+    // the raw uart bridge and the radio module are never touched, only the affected subsystems restart
+    if (changes & NETWORK_SETTINGS)
+        _reconfigureNetwork();
+
+    if (changes & SETTING_HOSTNAME)
+    {
+        int64_t started = esp_timer_get_time();
+        _mdns->stop();
+        _mdns->start(_settings);
+        _recordOutage(RECONFIGURE_MDNS, started);
+    }
+
+    if (changes & (NTP_SETTINGS | GPS_SETTINGS | DCF_SETTINGS))
+        _reconfigureTimesources(changes);
+
+    if (changes & (SETTING_SYSLOG_SERVER | SETTING_SYSLOG_LEVEL))
+        _syslog->reconfigure();
+
+    if (changes & SETTING_LED_BRIGHTNESS)
+    {
+        int64_t started = esp_timer_get_time();
+        LED::setBrightness(_settings->getLEDBrightness());
+        _recordOutage(RECONFIGURE_LED, started);
+    }
+}
+
+void Reconfigurator::_reconfigureNetwork()
+{
+    int64_t started = esp_timer_get_time();
+    _ethernet->reconfigure();
+
+    // the outage lasts until the interface has an address again
+    for (int i = 0; i < NETWORK_TIMEOUT_MS / 10 && !_ethernet->isConnected(); i++)
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+
+    if (!_ethernet->isConnected())
+        ESP_LOGW(TAG, "No IP address after %d ms", NETWORK_TIMEOUT_MS);
+
+    _recordOutage(RECONFIGURE_NETWORK, started);
+}
+
+void Reconfigurator::_reconfigureTimesources(uint32_t changes)
+{
+    bool ntpEnabled = _settings->isTimesourceEnabled(TIMESOURCE_NTP);
+    bool gpsEnabled = _settings->isTimesourceEnabled(TIMESOURCE_GPS);
+    bool dcfEnabled = _settings->isTimesourceEnabled(TIMESOURCE_DCF);
+
+    bool restartNtp = _ntpRunning != ntpEnabled || (ntpEnabled && (changes & SETTING_NTP_SERVER));
+    bool restartGps = _gpsRunning != gpsEnabled || (gpsEnabled && (changes & (SETTING_GPS_BAUDRATE | SETTING_GPS_PPS_PIN)));
+    // the DCF calibration depends on NTP being available
+    bool restartDcf = _dcfRunning != dcfEnabled || (dcfEnabled && ((changes & SETTING_DCF_CALIBRATION) || _ntpRunning != ntpEnabled));
+
+    int64_t started = esp_timer_get_time();
+
+    if (restartNtp && _ntpRunning)
+    {
+        _ntpClient->stop();
+        _ntpRunning = false;
+    }
+
+    // GPS and DCF share the receiver pin, release it before either one starts again
+    if (restartGps && _gpsRunning)
+    {
+        _gps->stop();
+        _gpsRunning = false;
+    }
+    if (restartDcf && _dcfRunning)
+    {
+        _dcf->stop();
+        _dcfRunning = false;
+    }
+
+    if (restartNtp && ntpEnabled)
+    {
+        _ntpClient->start();
+        _ntpRunning = true;
+    }
+    if (restartGps && gpsEnabled)
+    {
+        _gps->start();
+        _gpsRunning = true;
+    }
+    if (restartDcf && dcfEnabled)
+    {
+        _dcf->start();
+        _dcfRunning = true;
+    }
+
+    if (restartNtp)
+        _recordOutage(RECONFIGURE_NTP, started);
+    if (restartGps)
+        _recordOutage(RECONFIGURE_GPS, started);
+    if (restartDcf)
+        _recordOutage(RECONFIGURE_DCF, started);
+}
@@ -0,0 +1,297 @@
+/* 
+ *  remotesyslog.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+
+#include "remotesyslog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/param.h>
+#include "esp_timer.h"
+#include "lwip/api.h"
+#include "udphelper.h"
+
+static const char *TAG = "RemoteSyslog";
+
+static RemoteSyslog *_instance = NULL;
+static vprintf_like_t _previousVprintf = NULL;
+static volatile esp_log_level_t _minLevel = ESP_LOG_NONE;
+static volatile uint32_t _dropped = 0;
+
+typedef struct
+{
+    time_t sec;
+    uint16_t msec;
+    uint8_t level;
+} syslog_entry_header_t;
+
+static esp_log_level_t levelFromChar(char c)
+{
+    switch (c)
+    {
+    case 'E':
+        return ESP_LOG_ERROR;
+    case 'W':
+        return ESP_LOG_WARN;
+    case 'I':
+        return ESP_LOG_INFO;
+    case 'D':
+        return ESP_LOG_DEBUG;
+    case 'V':
+        return ESP_LOG_VERBOSE;
+    default:
+        return ESP_LOG_NONE;
+    }
+}
+
+// skips the color escape sequence esp_log puts in front of the level letter
+static const char *skipColor(const char *s)
+{
+    if (s[0] == '\033' && s[1] == '[')
+    {
+        const char *end = strchr(s, 'm');
+        if (end)
+            return end + 1;
+    }
+    return s;
+}
+
+static int syslogVprintf(const char *format, va_list args)
+{
+    if (_instance != NULL && _minLevel != ESP_LOG_NONE)
+        _instance->_capture(format, args);
+
+    return _previousVprintf(format, args);
+}
+
+void syslogTask(void *parameter)
+{
+    ((RemoteSyslog *)parameter)->_syslogTask();
+}
+
+RemoteSyslog::RemoteSyslog(Settings *settings) : _settings(settings)
+{
+}
+
+void RemoteSyslog::start()
+{
+    _buffer = xRingbufferCreate(SYSLOG_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+    _pcb = udp_new();
+
+    reconfigure();
+
+    // below the raw-uart and NTP tasks, the sink only uses idle time
+    xTaskCreate(syslogTask, "RemoteSyslog", 3072, this, 2, &_tHandle);
+
+    _instance = this;
+    _previousVprintf = esp_log_set_vprintf(syslogVprintf);
+}
+
+void RemoteSyslog::stop()
+{
+    esp_log_set_vprintf(_previousVprintf);
+    _instance = NULL;
+
+    vTaskDelete(_tHandle);
+    _udp_remove(_pcb);
+    vRingbufferDelete(_buffer);
+}
+
+void RemoteSyslog::reconfigure()
+{
+    _resolved = false;
+    _nextResolve = 0;
+
+    int level = _settings->getSyslogLevel();
+    if (strlen(_settings->getSyslogServer()) == 0 || level <= ESP_LOG_NONE)
+        _minLevel = ESP_LOG_NONE;
+    else
+        _minLevel = (esp_log_level_t)(level > ESP_LOG_VERBOSE ? ESP_LOG_VERBOSE : level);
+}
+
+uint32_t RemoteSyslog::getDroppedCount()
+{
+    return _dropped;
+}
+
+int RemoteSyslog::_capture(const char *format, va_list args)
+{
+    // the bridge and time capture tasks must not pay for formatting, they report through the event log instead
+    if (uxTaskPriorityGet(NULL) >= SYSLOG_MAX_CAPTURE_PRIORITY)
+        return 0;
+
+    // reject by the level letter of the format before paying for formatting
+    esp_log_level_t level = levelFromChar(*skipColor(format));
+    if (level != ESP_LOG_NONE && level > _minLevel)
+        return 0;
+
+    struct
+    {
+        syslog_entry_header_t header;
+        char line[SYSLOG_MAX_LINE];
+    } entry;
+
+    va_list copy;
+    va_copy(copy, args);
+    int len = vsnprintf(entry.line, sizeof(entry.line), format, copy);
+    va_end(copy);
+
+    if (len <= 0)
+        return 0;
+    if (len >= (int)sizeof(entry.line))
+        len = sizeof(entry.line) - 1;
+
+    // deferred records are formatted by the caller, the level is only known after formatting
+    if (level == ESP_LOG_NONE)
+    {
+        level = levelFromChar(*skipColor(entry.line));
+        if (level == ESP_LOG_NONE || level > _minLevel)
+            return 0;
+    }
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    entry.header.sec = tv.tv_sec;
+    entry.header.msec = tv.tv_usec / 1000;
+    entry.header.level = level;
+
+    // never wait for space, a full buffer drops the line
+    if (xRingbufferSend(_buffer, &entry, sizeof(syslog_entry_header_t) + len + 1, 0) != pdTRUE)
+        _dropped++;
+
+    return len;
+}
+
+bool RemoteSyslog::_resolve()
+{
+    if (_resolved)
+        return true;
+
+    int64_t now = esp_timer_get_time();
+    if (now < _nextResolve)
+        return false;
+    _nextResolve = now + SYSLOG_RESOLVE_INTERVAL;
+
+    char host[65];
+    strncpy(host, _settings->getSyslogServer(), sizeof(host) - 1);
+    host[sizeof(host) - 1] = 0;
+
+    _port = SYSLOG_DEFAULT_PORT;
+    char *colon = strrchr(host, ':');
+    if (colon)
+    {
+        *colon = 0;
+        _port = atoi(colon + 1);
+    }
+
+    if (!ipaddr_aton(host, &_addr) && netconn_gethostbyname(host, &_addr) != ERR_OK)
+    {
+        ESP_LOGW(TAG, "Could not resolve %s", host);
+        return false;
+    }
+
+    _resolved = true;
+    return true;
+}
+
+void RemoteSyslog::_send(const char *entry, size_t len)
+{
+    syslog_entry_header_t header;
+    memcpy(&header, entry, sizeof(header));
+
+    // esp_log line: "E (1234) tag: message", optionally followed by a color reset and a newline
+    const char *line = skipColor(entry + sizeof(header));
+    const char *end = entry + len - 1;
+
+    const char *tag = "-";
+    int tagLen = 1;
+    const char *message = line;
+
+    const char *tagStart = strchr(line, ')');
+    if (tagStart && tagStart[1] == ' ')
+    {
+        tagStart += 2;
+        const char *tagEnd = strstr(tagStart, ": ");
+        if (tagEnd)
+        {
+            tag = tagStart;
+            tagLen = MIN(tagEnd - tagStart, 32); // MSGID is limited to 32 characters
+            message = tagEnd + 2;
+        }
+    }
+
+    while (end > message && (end[-1] == '\n' || end[-1] == '\r'))
+        end--;
+    if (end - message >= 4 && memcmp(end - 4, "\033[0m", 4) == 0)
+        end -= 4;
+
+    // RFC 5424: <PRI>VERSION TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA MSG, facility local0
+    static const uint8_t severities[] = {7, 3, 4, 6, 7, 7};
+    int pri = 16 * 8 + severities[header.level];
+
+    char timestamp[32];
+    if (header.sec > 1600000000)
+    {
+        struct tm tm;
+        gmtime_r(&header.sec, &tm);
+        size_t pos = strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &tm);
+        snprintf(timestamp + pos, sizeof(timestamp) - pos, ".%03dZ", header.msec);
+    }
+    else
+    {
+        // no valid time yet
+        strcpy(timestamp, "-");
+    }
+
+    char packet[SYSLOG_MAX_LINE + 160];
+    int packetLen = snprintf(packet, sizeof(packet), "<%d>1 %s %s HB-RF-ETH - %.*s - %.*s", pri, timestamp, _settings->getHostname(), tagLen, tag, (int)(end - message), message);
+    if (packetLen >= (int)sizeof(packet))
+        packetLen = sizeof(packet) - 1;
+
+    pbuf *pb = pbuf_alloc(PBUF_TRANSPORT, packetLen, PBUF_RAM);
+    if (pb == NULL)
+    {
+        _dropped++;
+        return;
+    }
+    memcpy(pb->payload, packet, packetLen);
+    _udp_sendto(_pcb, pb, &_addr, _port);
+    pbuf_free(pb);
+}
+
+void RemoteSyslog::_syslogTask()
+{
+    size_t len;
+
+    for (;;)
+    {
+        char *entry = (char *)xRingbufferReceive(_buffer, &len, portMAX_DELAY);
+        if (entry == NULL)
+            continue;
+
+        if (len > sizeof(syslog_entry_header_t) && _minLevel != ESP_LOG_NONE && _resolve())
+            _send(entry, len);
+        else
+            _dropped++;
+
+        vRingbufferReturnItem(_buffer, entry);
+    }
+}
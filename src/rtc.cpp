@@ -20,20 +20,18 @@
 #include <stdint.h>
 #include "rtc.h"
 #include "esp_log.h"
+#include "calendar.h"
+#include "esp_timer.h"
 
 static const char *TAG = "RTC";
 
-static uint8_t bcd2bin(uint8_t val)
-{
-    return val - 6 * (val >> 4);
-}
-
-static uint8_t bin2bcd(uint8_t val)
-{
-    return val + 6 * (val / 10);
-}
+#define DS3231_CONTROL_REGISTER 0x0e
+#define DS3231_CONTROL_CONV 0x20
+#define DS3231_AGING_OFFSET_REGISTER 0x10
+#define DS3231_AGING_OFFSET_STEP 100 // ppb, typical at 25 degree celsius
 
-const uint8_t daysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+#define RX8130_DIGITAL_OFFSET_REGISTER 0x30
+#define RX8130_DIGITAL_OFFSET_STEP 3052 // ppb, one 32768 Hz cycle every 10 seconds (RX8130CE application manual)
 
 static bool _isDriverInstalled = false;
 
@@ -129,65 +127,84 @@ struct timeval Rtc::GetTime()
         return res;
     }
 
-    res.tv_sec = bcd2bin(rawData[0]);         // seconds
-    res.tv_sec += bcd2bin(rawData[1]) * 60;   // minutes
-    res.tv_sec += bcd2bin(rawData[2]) * 3600; // hours
+    res.tv_sec = epochFromCivil(2000 + bcd2bin(rawData[6]), bcd2bin(rawData[5]), bcd2bin(rawData[4]), bcd2bin(rawData[2]), bcd2bin(rawData[1]), bcd2bin(rawData[0]));
 
-    uint16_t days = bcd2bin(rawData[4]);
-    uint8_t month = bcd2bin(rawData[5]);
-    uint8_t year = bcd2bin(rawData[6]);
+    return res;
+}
 
-    for (uint8_t i = 1; i < month; ++i)
-    {
-        days += daysInMonth[i - 1];
-    }
+bool Rtc::readRegister(uint8_t reg, uint8_t *value)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, _address << 1 | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(cmd, reg, true);
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, _address << 1 | I2C_MASTER_READ, true);
+    i2c_master_read_byte(cmd, value, I2C_MASTER_NACK);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_master_cmd_begin(I2C_NUM_0, cmd, 50 / portTICK_RATE_MS);
+    i2c_cmd_link_delete(cmd);
 
-    if (month > 2 && year % 4 == 0)
-        days++;
+    return ret == ESP_OK;
+}
+
+bool Rtc::writeRegister(uint8_t reg, uint8_t value)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, _address << 1 | I2C_MASTER_WRITE, true);
+    i2c_master_write_byte(cmd, reg, true);
+    i2c_master_write_byte(cmd, value, true);
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_master_cmd_begin(I2C_NUM_0, cmd, 50 / portTICK_RATE_MS);
+    i2c_cmd_link_delete(cmd);
 
-    days += 365 * year + (year + 3) / 4 - 1;
+    return ret == ESP_OK;
+}
 
-    res.tv_sec += days * 86400;
+struct timeval Rtc::GetTimeAligned(int32_t *alignmentError)
+{
+    uint8_t startSeconds, seconds;
+    int64_t start = esp_timer_get_time();
+    int64_t lastRead = start;
 
-    res.tv_sec += 10957 * 86400; // epoch diff 1970 vs. 2000
+    if (readRegister(_reg_start, &startSeconds))
+    {
+        lastRead = esp_timer_get_time();
+
+        // poll until the seconds register increments, the rollover happened between the last two reads
+        while (lastRead - start < 1100000)
+        {
+            int64_t previousRead = lastRead;
+            if (!readRegister(_reg_start, &seconds))
+                break;
+            lastRead = esp_timer_get_time();
+
+            if (seconds != startSeconds)
+            {
+                int64_t rollover = (previousRead + lastRead) / 2;
+                struct timeval res = GetTime();
+                res.tv_usec = esp_timer_get_time() - rollover;
+                *alignmentError = (lastRead - previousRead) / 2;
+                return res;
+            }
+        }
+    }
 
-    return res;
+    ESP_LOGW(TAG, "Could not detect seconds rollover of RTC");
+    *alignmentError = 1000000;
+    return GetTime();
 }
 
 void Rtc::SetTime(struct timeval now)
 {
-    now.tv_sec -= 10957 * 86400; // epoch diff 1970 vs. 2000
-
     uint8_t seconds = now.tv_sec % 60;
-    now.tv_sec /= 60;
-    uint8_t minutes = now.tv_sec % 60;
-    now.tv_sec /= 60;
-    uint8_t hours = now.tv_sec % 24;
-
-    uint16_t days = now.tv_sec / 24;
+    uint8_t minutes = (now.tv_sec / 60) % 60;
+    uint8_t hours = (now.tv_sec / 3600) % 24;
 
-    uint8_t leap;
-    uint8_t year;
-
-    for (year = 0;; year++)
-    {
-        leap = year % 4 == 0;
-        if (days < 365 + leap)
-            break;
-        days -= 365 + leap;
-    }
-
-    uint8_t month;
-    for (month = 1;; month++)
-    {
-        uint8_t daysPerMonth = daysInMonth[month - 1];
-        if (leap && month == 2)
-            ++daysPerMonth;
-        if (days < daysPerMonth)
-            break;
-        days -= daysPerMonth;
-    }
-    days++;
+    int year, month, days;
+    civilFromDays(now.tv_sec / 86400, &year, &month, &days);
+    year -= 2000;
 
     i2c_cmd_handle_t cmd = i2c_cmd_link_create();
     i2c_master_start(cmd);
@@ -210,10 +227,55 @@ void Rtc::SetTime(struct timeval now)
     }
 }
 
+int32_t Rtc::Trim(int32_t ppb)
+{
+    return 0;
+}
+
+int32_t Rtc::GetTrim()
+{
+    return _trim;
+}
+
 RtcDS3231::RtcDS3231() : Rtc::Rtc(0x68, 0)
 {
 }
 
+bool RtcDS3231::begin()
+{
+    if (!Rtc::begin())
+        return false;
+
+    uint8_t aging;
+    if (readRegister(DS3231_AGING_OFFSET_REGISTER, &aging))
+        _trim = -(int8_t)aging * DS3231_AGING_OFFSET_STEP;
+
+    return true;
+}
+
+int32_t RtcDS3231::Trim(int32_t ppb)
+{
+    // a positive aging offset adds capacitance, which slows the oscillator down
+    int32_t aging = -_trim / DS3231_AGING_OFFSET_STEP - (ppb + (ppb >= 0 ? 1 : -1) * DS3231_AGING_OFFSET_STEP / 2) / DS3231_AGING_OFFSET_STEP;
+    aging = aging < -128 ? -128 : (aging > 127 ? 127 : aging);
+
+    if (!writeRegister(DS3231_AGING_OFFSET_REGISTER, (uint8_t)(int8_t)aging))
+    {
+        ESP_LOGE(TAG, "Could not write aging offset to RTC");
+        return 0;
+    }
+
+    // the aging offset is applied with the next temperature conversion, start one right now
+    uint8_t control;
+    if (readRegister(DS3231_CONTROL_REGISTER, &control))
+        writeRegister(DS3231_CONTROL_REGISTER, control | DS3231_CONTROL_CONV);
+
+    int32_t trim = -aging * DS3231_AGING_OFFSET_STEP;
+    int32_t res = trim - _trim;
+    _trim = trim;
+    return res;
+}
+
 RtcRX8130::RtcRX8130() : Rtc::Rtc(0x32, 0x10)
 {
 }
@@ -231,6 +293,13 @@ bool RtcRX8130::begin()
         esp_err_t ret = i2c_master_cmd_begin(I2C_NUM_0, cmd, 50 / portTICK_RATE_MS);
         i2c_cmd_link_delete(cmd);
 
+        uint8_t offset;
+        if (ret == ESP_OK && readRegister(RX8130_DIGITAL_OFFSET_REGISTER, &offset) && (offset & 0x80))
+        {
+            // 7 bit two's complement
+            _trim = ((int8_t)(offset << 1) >> 1) * RX8130_DIGITAL_OFFSET_STEP;
+        }
+
         return ret == ESP_OK;
     }
     else
@@ -238,3 +307,21 @@ bool RtcRX8130::begin()
         return false;
     }
 }
+
+int32_t RtcRX8130::Trim(int32_t ppb)
+{
+    int32_t offset = _trim / RX8130_DIGITAL_OFFSET_STEP + (ppb + (ppb >= 0 ? 1 : -1) * RX8130_DIGITAL_OFFSET_STEP / 2) / RX8130_DIGITAL_OFFSET_STEP;
+    offset = offset < -64 ? -64 : (offset > 63 ? 63 : offset);
+
+    uint8_t value = offset == 0 ? 0 : (0x80 | (offset & 0x7f));
+    if (!writeRegister(RX8130_DIGITAL_OFFSET_REGISTER, value))
+    {
+        ESP_LOGE(TAG, "Could not write digital offset to RTC");
+        return 0;
+    }
+
+    int32_t trim = offset * RX8130_DIGITAL_OFFSET_STEP;
+    int32_t res = trim - _trim;
+    _trim = trim;
+    return res;
+}
@@ -18,17 +18,48 @@
  */
 
 #include "settings.h"
+#include "pins.h"
 #include "nvs.h"
 #include "nvs_flash.h"
+#include "esp_log.h"
+#include "esp_system.h"
 #include <string.h>
 
+static const char *TAG = "Settings";
+static const char *NVS_NAMESPACE = "HB-RF-ETH";
+
+static Settings *_instance = NULL;
+
+static void commitTimerCallback(void *arg)
+{
+  ((Settings *)arg)->save();
+}
+
+static void saveOnShutdown()
+{
+  // writes a pending deferred commit before esp_restart()
+  if (_instance != NULL)
+    _instance->save();
+}
+
 Settings::Settings()
 {
+  _mutex = xSemaphoreCreateMutex();
+  _saveMutex = xSemaphoreCreateMutex();
+
   load();
-}
 
-static const char *TAG = "Settings";
-static const char *NVS_NAMESPACE = "HB-RF-ETH";
+  esp_timer_create_args_t timerArgs = {
+      .callback = commitTimerCallback,
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "Settings_Commit",
+  };
+  ESP_ERROR_CHECK_WITHOUT_ABORT(esp_timer_create(&timerArgs, &_commitTimer));
+
+  _instance = this;
+  esp_register_shutdown_handler(saveOnShutdown);
+}
 
 #define GET_IP_ADDR(handle, name, var, defaultValue)  \
   if (nvs_get_u32(handle, name, &var.addr) != ESP_OK) \
@@ -53,10 +84,37 @@ static const char *NVS_NAMESPACE = "HB-RF-ETH";
     var = (__##var##_temp != 0);                           \
   }
 
-#define SET_IP_ADDR(handle, name, var) ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u32(handle, name, var.addr));
-#define SET_INT(handle, name, var) ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_i32(handle, name, var));
-#define SET_STR(handle, name, var) ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_str(handle, name, var));
-#define SET_BOOL(handle, name, var) ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_i8(handle, name, var ? 1 : 0));
+#define SET_IP_ADDR(handle, name, var, setting) \
+  if (dirty & setting)                         \
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_u32(handle, name, var.addr));
+#define SET_INT(handle, name, var, setting) \
+  if (dirty & setting)                     \
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_i32(handle, name, var));
+#define SET_STR(handle, name, var, setting) \
+  if (dirty & setting)                     \
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_str(handle, name, var));
+#define SET_BOOL(handle, name, var, setting) \
+  if (dirty & setting)                      \
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_set_i8(handle, name, var ? 1 : 0));
+
+#define UPDATE_VALUE(var, value, setting) \
+  if (var != value)                       \
+  {                                       \
+    var = value;                          \
+    _dirty |= setting;                    \
+  }
+#define UPDATE_IP_ADDR(var, value, setting) \
+  if (var.addr != value.addr)               \
+  {                                         \
+    var = value;                            \
+    _dirty |= setting;                      \
+  }
+#define UPDATE_STR(var, value, setting)                           \
+  if (value != NULL && strncmp(var, value, sizeof(var) - 1) != 0) \
+  {                                                               \
+    strncpy(var, value, sizeof(var) - 1);                         \
+    _dirty |= setting;                                            \
+  }
 
 void Settings::load()
 {
@@ -93,11 +151,20 @@ void Settings::load()
   GET_IP_ADDR(handle, "dns1", _dns1, IPADDR_ANY);
   GET_IP_ADDR(handle, "dns2", _dns2, IPADDR_ANY);
 
-  GET_INT(handle, "timesource", _timesource, TIMESOURCE_NTP);
+  int timesource;
+  GET_INT(handle, "timesource", timesource, TIMESOURCE_NTP);
+  GET_INT(handle, "timesources", _timesources, 1 << timesource);
   
   GET_INT(handle, "dcfOffset", _dcfOffset, 40000);
+  GET_BOOL(handle, "dcfCalibration", _dcfCalibration, true);
 
   GET_INT(handle, "gpsBaudrate", _gpsBaudrate, 9600);
+  GET_INT(handle, "gpsPpsPin", _gpsPpsPin, -1);
+  if (!isValidGpsPpsPin(_gpsPpsPin))
+  {
+    ESP_LOGW(TAG, "Ignoring stored GPS PPS pin %d", _gpsPpsPin);
+    _gpsPpsPin = -1;
+  }
 
   size_t ntpServerLength = sizeof(_ntpServer);
   if (nvs_get_str(handle, "ntpServer", _ntpServer, &ntpServerLength) != ESP_OK)
@@ -107,36 +174,114 @@ void Settings::load()
 
   GET_INT(handle, "ledBrightness", _ledBrightness, 100);
 
+  size_t syslogServerLength = sizeof(_syslogServer);
+  if (nvs_get_str(handle, "syslogServer", _syslogServer, &syslogServerLength) != ESP_OK)
+  {
+    _syslogServer[0] = 0;
+  }
+  GET_INT(handle, "syslogLevel", _syslogLevel, 0);
+
+  GET_INT(handle, "liveStatusIntv", _liveStatusInterval, 1000);
+
   nvs_close(handle);
 }
 
 void Settings::save()
 {
+  // serializes the writers, so an older snapshot never overwrites a newer one in NVS
+  xSemaphoreTake(_saveMutex, portMAX_DELAY);
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+
+  if (_commitTimer != NULL)
+    esp_timer_stop(_commitTimer);
+
+  uint32_t dirty = _dirty;
+  _dirty = 0;
+
+  // setters only wait for the copy, not for the flash writes
+  Settings snapshot(*this);
+
+  xSemaphoreGive(_mutex);
+
+  if (dirty == 0)
+  {
+    xSemaphoreGive(_saveMutex);
+    return;
+  }
+
   uint32_t handle;
 
   ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle));
 
-  SET_STR(handle, "adminPassword", _adminPassword);
+  SET_STR(handle, "adminPassword", snapshot._adminPassword, SETTING_ADMIN_PASSWORD);
 
-  SET_STR(handle, "hostname", _hostname);
-  SET_BOOL(handle, "useDHCP", _useDHCP);
-  SET_IP_ADDR(handle, "localIP", _localIP);
-  SET_IP_ADDR(handle, "netmask", _netmask);
-  SET_IP_ADDR(handle, "gateway", _gateway);
-  SET_IP_ADDR(handle, "dns1", _dns1);
-  SET_IP_ADDR(handle, "dns2", _dns2);
+  SET_STR(handle, "hostname", snapshot._hostname, SETTING_HOSTNAME);
+  SET_BOOL(handle, "useDHCP", snapshot._useDHCP, SETTING_USE_DHCP);
+  SET_IP_ADDR(handle, "localIP", snapshot._localIP, SETTING_LOCAL_IP);
+  SET_IP_ADDR(handle, "netmask", snapshot._netmask, SETTING_NETMASK);
+  SET_IP_ADDR(handle, "gateway", snapshot._gateway, SETTING_GATEWAY);
+  SET_IP_ADDR(handle, "dns1", snapshot._dns1, SETTING_DNS1);
+  SET_IP_ADDR(handle, "dns2", snapshot._dns2, SETTING_DNS2);
 
-  SET_INT(handle, "timesource", _timesource);
+  SET_INT(handle, "timesources", snapshot._timesources, SETTING_TIMESOURCES);
 
-  SET_INT(handle, "dcfOffset", _dcfOffset);
+  SET_INT(handle, "dcfOffset", snapshot._dcfOffset, SETTING_DCF_OFFSET);
+  SET_BOOL(handle, "dcfCalibration", snapshot._dcfCalibration, SETTING_DCF_CALIBRATION);
 
-  SET_INT(handle, "gpsBaudrate", _gpsBaudrate);
+  SET_INT(handle, "gpsBaudrate", snapshot._gpsBaudrate, SETTING_GPS_BAUDRATE);
+  SET_INT(handle, "gpsPpsPin", snapshot._gpsPpsPin, SETTING_GPS_PPS_PIN);
 
-  SET_STR(handle, "ntpServer", _ntpServer);
+  SET_STR(handle, "ntpServer", snapshot._ntpServer, SETTING_NTP_SERVER);
 
-  SET_INT(handle, "ledBrightness", _ledBrightness);
+  SET_INT(handle, "ledBrightness", snapshot._ledBrightness, SETTING_LED_BRIGHTNESS);
 
+  SET_STR(handle, "syslogServer", snapshot._syslogServer, SETTING_SYSLOG_SERVER);
+  SET_INT(handle, "syslogLevel", snapshot._syslogLevel, SETTING_SYSLOG_LEVEL);
+
+  SET_INT(handle, "liveStatusIntv", snapshot._liveStatusInterval, SETTING_LIVE_STATUS_INTERVAL);
+
+  // all changed keys in one commit
+  ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(handle));
   nvs_close(handle);
+
+  xSemaphoreGive(_saveMutex);
+
+  ESP_LOGI(TAG, "Saved settings 0x%04x", dirty);
+
+  if (_changeHandler != NULL)
+    _changeHandler(_changeHandlerContext, dirty);
+}
+
+void Settings::saveDeferred(uint32_t delayMs)
+{
+  if (_commitTimer == NULL)
+  {
+    save();
+    return;
+  }
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+
+  if (_dirty != 0)
+  {
+    // every change restarts the delay, so a burst of edits results in a single write
+    esp_timer_stop(_commitTimer);
+    esp_timer_start_once(_commitTimer, delayMs * 1000ULL);
+  }
+
+  xSemaphoreGive(_mutex);
+}
+
+uint32_t Settings::getDirty()
+{
+  return _dirty;
+}
+
+void Settings::setChangeHandler(settings_change_handler_t handler, void *context)
+{
+  _changeHandlerContext = context;
+  _changeHandler = handler;
 }
 
 void Settings::clear()
@@ -148,7 +293,15 @@ void Settings::clear()
   ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(handle));
   nvs_close(handle);
 
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+
+  if (_commitTimer != NULL)
+    esp_timer_stop(_commitTimer);
+  _dirty = 0;
+
   load();
+
+  xSemaphoreGive(_mutex);
 }
 
 char *Settings::getAdminPassword()
@@ -158,7 +311,9 @@ char *Settings::getAdminPassword()
 
 void Settings::setAdminPassword(char *adminPassword)
 {
-  strncpy(_adminPassword, adminPassword, sizeof(_adminPassword) - 1);
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  UPDATE_STR(_adminPassword, adminPassword, SETTING_ADMIN_PASSWORD);
+  xSemaphoreGive(_mutex);
 }
 
 char *Settings::getHostname()
@@ -198,13 +353,15 @@ ip4_addr_t Settings::getDns2()
 
 void Settings::setNetworkSettings(char *hostname, bool useDHCP, ip4_addr_t localIP, ip4_addr_t netmask, ip4_addr_t gateway, ip4_addr_t dns1, ip4_addr_t dns2)
 {
-  strncpy(_hostname, hostname, sizeof(_hostname) - 1);
-  _useDHCP = useDHCP;
-  _localIP = localIP;
-  _netmask = netmask;
-  _gateway = gateway;
-  _dns1 = dns1;
-  _dns2 = dns2;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  UPDATE_STR(_hostname, hostname, SETTING_HOSTNAME);
+  UPDATE_VALUE(_useDHCP, useDHCP, SETTING_USE_DHCP);
+  UPDATE_IP_ADDR(_localIP, localIP, SETTING_LOCAL_IP);
+  UPDATE_IP_ADDR(_netmask, netmask, SETTING_NETMASK);
+  UPDATE_IP_ADDR(_gateway, gateway, SETTING_GATEWAY);
+  UPDATE_IP_ADDR(_dns1, dns1, SETTING_DNS1);
+  UPDATE_IP_ADDR(_dns2, dns2, SETTING_DNS2);
+  xSemaphoreGive(_mutex);
 }
 
 int Settings::getDcfOffset()
@@ -214,7 +371,21 @@ int Settings::getDcfOffset()
 
 void Settings::setDcfOffset(int dcfOffset)
 {
-  _dcfOffset = dcfOffset;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  UPDATE_VALUE(_dcfOffset, dcfOffset, SETTING_DCF_OFFSET);
+  xSemaphoreGive(_mutex);
+}
+
+bool Settings::getDcfCalibration()
+{
+  return _dcfCalibration;
+}
+
+void Settings::setDcfCalibration(bool dcfCalibration)
+{
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  UPDATE_VALUE(_dcfCalibration, dcfCalibration, SETTING_DCF_CALIBRATION);
+  xSemaphoreGive(_mutex);
 }
 
 int Settings::getGpsBaudrate()
@@ -224,17 +395,51 @@ int Settings::getGpsBaudrate()
 
 void Settings::setGpsBaudrate(int gpsBaudrate)
 {
-  _gpsBaudrate = gpsBaudrate;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  UPDATE_VALUE(_gpsBaudrate, gpsBaudrate, SETTING_GPS_BAUDRATE);
+  xSemaphoreGive(_mutex);
+}
+
+int Settings::getGpsPpsPin()
+{
+  return _gpsPpsPin;
+}
+
+void Settings::setGpsPpsPin(int gpsPpsPin)
+{
+  if (!isValidGpsPpsPin(gpsPpsPin))
+  {
+    ESP_LOGW(TAG, "GPIO %d can not be used as GPS PPS input", gpsPpsPin);
+    return;
+  }
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  UPDATE_VALUE(_gpsPpsPin, gpsPpsPin, SETTING_GPS_PPS_PIN);
+  xSemaphoreGive(_mutex);
 }
 
-timesource_t Settings::getTimesource()
+int Settings::getTimesources()
 {
-  return (timesource_t)_timesource;
+  return _timesources;
 }
 
-void Settings::setTimesource(timesource_t timesource)
+bool Settings::isTimesourceEnabled(timesource_t timesource)
 {
-  _timesource = timesource;
+  return (_timesources & (1 << timesource)) != 0;
+}
+
+void Settings::setTimesources(int timesources)
+{
+  // DCF and GPS receivers share the same input pin
+  if ((timesources & (1 << TIMESOURCE_GPS)) && (timesources & (1 << TIMESOURCE_DCF)))
+  {
+    ESP_LOGW(TAG, "DCF and GPS can not be used at the same time, using GPS");
+    timesources &= ~(1 << TIMESOURCE_DCF);
+  }
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  UPDATE_VALUE(_timesources, timesources, SETTING_TIMESOURCES);
+  xSemaphoreGive(_mutex);
 }
 
 char *Settings::getNtpServer()
@@ -244,7 +449,9 @@ char *Settings::getNtpServer()
 
 void Settings::setNtpServer(char *ntpServer)
 {
-  strncpy(_ntpServer, ntpServer, sizeof(_ntpServer) - 1);
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  UPDATE_STR(_ntpServer, ntpServer, SETTING_NTP_SERVER);
+  xSemaphoreGive(_mutex);
 }
 
 int Settings::getLEDBrightness()
@@ -254,5 +461,43 @@ int Settings::getLEDBrightness()
 
 void Settings::setLEDBrightness(int ledBrightness)
 {
-  _ledBrightness = ledBrightness;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  UPDATE_VALUE(_ledBrightness, ledBrightness, SETTING_LED_BRIGHTNESS);
+  xSemaphoreGive(_mutex);
+}
+
+char *Settings::getSyslogServer()
+{
+  return _syslogServer;
+}
+
+void Settings::setSyslogServer(char *syslogServer)
+{
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  UPDATE_STR(_syslogServer, syslogServer, SETTING_SYSLOG_SERVER);
+  xSemaphoreGive(_mutex);
+}
+
+int Settings::getSyslogLevel()
+{
+  return _syslogLevel;
+}
+
+void Settings::setSyslogLevel(int syslogLevel)
+{
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  UPDATE_VALUE(_syslogLevel, syslogLevel, SETTING_SYSLOG_LEVEL);
+  xSemaphoreGive(_mutex);
+}
+
+int Settings::getLiveStatusInterval()
+{
+  return _liveStatusInterval;
+}
+
+void Settings::setLiveStatusInterval(int liveStatusInterval)
+{
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  UPDATE_VALUE(_liveStatusInterval, liveStatusInterval, SETTING_LIVE_STATUS_INTERVAL);
+  xSemaphoreGive(_mutex);
 }
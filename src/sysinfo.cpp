@@ -29,51 +29,11 @@
 
 static const char *TAG = "SysInfo";
 
-static double _cpuUsage;
+static Profiler *_profiler;
 static char _serial[13];
 static const char *_currentVersion;
 static board_type_t _board;
 
-void updateCPUUsageTask(void *arg)
-{
-    TaskStatus_t *taskStatus = (TaskStatus_t *)malloc(25 * sizeof(TaskStatus_t));
-
-    TaskHandle_t idle0Task = xTaskGetIdleTaskHandleForCPU(0);
-    TaskHandle_t idle1Task = xTaskGetIdleTaskHandleForCPU(1);
-
-    uint32_t totalRunTime = 0, idleRunTime = 0, lastTotalRunTime = 0, lastIdleRunTime = 0;
-
-    for (;;)
-    {
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-
-        UBaseType_t taskCount = uxTaskGetSystemState(taskStatus, 25, &totalRunTime);
-
-        idleRunTime = 0;
-
-        if (totalRunTime > 0)
-        {
-            for (int i = 0; i < taskCount; i++)
-            {
-                TaskStatus_t ts = taskStatus[i];
-
-                if (ts.xHandle == idle0Task || ts.xHandle == idle1Task)
-                {
-                    idleRunTime += ts.ulRunTimeCounter;
-                }
-            }
-        }
-
-        _cpuUsage = 100.0 - ((idleRunTime - lastIdleRunTime) * 100.0 / ((totalRunTime - lastTotalRunTime) * 2));
-
-        lastIdleRunTime = idleRunTime;
-        lastTotalRunTime = totalRunTime;
-    }
-
-    free(taskStatus);
-    vTaskDelete(NULL);
-}
-
 uint32_t get_voltage(adc_unit_t adc_unit, adc_channel_t adc_channel, adc_bits_width_t adc_width, adc_atten_t adc_atten)
 {
     esp_adc_cal_characteristics_t *adc_chars = reinterpret_cast<esp_adc_cal_characteristics_t *>(calloc(1, sizeof(esp_adc_cal_characteristics_t)));
@@ -125,7 +85,8 @@ board_type_t detectBoard()
 
 SysInfo::SysInfo()
 {
-    xTaskCreate(updateCPUUsageTask, "UpdateCPUUsage", 4096, NULL, 3, NULL);
+    _profiler = new Profiler();
+    _profiler->start();
 
     uint8_t baseMac[6];
     esp_read_mac(baseMac, ESP_MAC_ETH);
@@ -138,7 +99,17 @@ SysInfo::SysInfo()
 
 double SysInfo::getCpuUsage()
 {
-    return _cpuUsage;
+    double usage = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        usage += _profiler->getCoreLoad(core, 0);
+    }
+    return usage / portNUM_PROCESSORS;
+}
+
+Profiler *SysInfo::getProfiler()
+{
+    return _profiler;
 }
 
 double SysInfo::getMemoryUsage()
@@ -20,51 +20,133 @@
 #include "systemclock.h"
 #include <sys/time.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 
 static const char *TAG = "SystemClock";
 
+#define RTC_CHECK_INTERVAL 600000000LL    // usec, compare the RTC with the system clock at most this often
+#define RTC_MAX_OFFSET 10000               // usec, the RTC time is only rewritten above, never used for the drift
+#define RTC_MIN_DRIFT_PERIOD 3600000000LL  // usec, gives a drift resolution below 1 ppm
+#define RTC_MAX_DRIFT 100000               // ppb
+
 #define get_tzname(isdst) isdst > 0 ? *(tzname + 1) : *tzname
 
+static const char *_sourceNames[CLOCK_SOURCE_COUNT] = {"none", "RTC", "NTP", "DCF", "GPS", "GPS+PPS"};
+
 void updateRtcTask(void *parameter)
 {
-    Rtc *_rtc = (Rtc *)parameter;
-
-    for (;;)
-    {
-        if (ulTaskNotifyTake(pdTRUE, portMAX_DELAY) != 1)
-            continue;
-
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-        _rtc->SetTime(tv);
-
-        struct tm now;
-        localtime_r(&tv.tv_sec, &now);
-
-        ESP_LOGI(TAG, "Updated RTC to %02d-%02d-%02d %02d:%02d:%02d %s", now.tm_year + 1900, now.tm_mon + 1, now.tm_mday, now.tm_hour, now.tm_min, now.tm_sec, get_tzname(now.tm_isdst));
-    }
-
-    vTaskDelete(NULL);
+    ((SystemClock *)parameter)->_updateRtc();
 }
 
 SystemClock::SystemClock(Rtc *rtc) : _rtc(rtc)
 {
+    _mutex = xSemaphoreCreateMutex();
 }
 
 void SystemClock::start(void)
 {
     if (_rtc)
     {
-        struct timeval tv = _rtc->GetTime();
+        struct timeval tv = _rtc->GetTimeAligned(&_rtcAlignmentError);
         settimeofday(&tv, NULL);
         _lastSyncTime = tv;
+        _syncSource = CLOCK_SOURCE_RTC;
 
         time_t nowtime = tv.tv_sec;
         struct tm *now = localtime(&nowtime);
 
-        ESP_LOGI(TAG, "Updated time from RTC to %02d-%02d-%02d %02d:%02d:%02d %s", now->tm_year + 1900, now->tm_mon + 1, now->tm_mday, now->tm_hour, now->tm_min, now->tm_sec, get_tzname(now->tm_isdst));
+        ESP_LOGI(TAG, "Updated time from RTC to %02d-%02d-%02d %02d:%02d:%02d.%06ld %s (+/- %d usec)", now->tm_year + 1900, now->tm_mon + 1, now->tm_mday, now->tm_hour, now->tm_min, now->tm_sec, tv.tv_usec, get_tzname(now->tm_isdst), _rtcAlignmentError);
 
-        xTaskCreate(updateRtcTask, "SystemClock_RtcUpdateTask", 4096, _rtc, 10, &_tHandle);
+        xTaskCreate(updateRtcTask, "SystemClock_RtcUpdateTask", 4096, this, 10, &_tHandle);
+    }
+}
+
+void SystemClock::_updateRtc()
+{
+    for (;;)
+    {
+        if (ulTaskNotifyTake(pdTRUE, portMAX_DELAY) != 1)
+            continue;
+
+        // only called right after a sync, so the system clock is the reference here
+        int64_t now = esp_timer_get_time();
+        if (_rtcBaseline != 0 && now - _lastRtcCheck < RTC_CHECK_INTERVAL)
+            continue;
+        _lastRtcCheck = now;
+
+        // the drift window only restarts when the trim changed, corrections of the time alone keep it running
+        bool restartWindow = true;
+        int64_t offset = 0;
+
+        if (_rtcBaseline != 0)
+        {
+            int32_t alignmentError;
+            struct timeval rtcTime = _rtc->GetTimeAligned(&alignmentError);
+            struct timeval sysTime;
+            gettimeofday(&sysTime, NULL);
+
+            offset = (rtcTime.tv_sec - sysTime.tv_sec) * 1000000LL + rtcTime.tv_usec - sysTime.tv_usec;
+            int64_t elapsed = esp_timer_get_time() - _rtcBaseline;
+            bool trimmed = false;
+
+            // the jitter of the sources (DCF, GPS without PPS) is only small enough compared to a long window
+            if (elapsed >= RTC_MIN_DRIFT_PERIOD)
+            {
+                int64_t drift = (offset + _rtcCorrected) * 1000000000LL / elapsed;
+
+                // larger values are caused by steps of the system clock, not by the RTC
+                if (drift < RTC_MAX_DRIFT && drift > -RTC_MAX_DRIFT)
+                {
+                    _rtcDrift = drift;
+                    int32_t trim = _rtc->Trim(-_rtcDrift);
+                    trimmed = trim != 0;
+
+                    ESP_LOGI(TAG, "RTC offset %lld usec after %lld sec, drift %d ppb, trimmed by %d ppb", offset + _rtcCorrected, elapsed / 1000000, _rtcDrift, trim);
+                }
+            }
+
+            if (!trimmed)
+            {
+                if (offset <= RTC_MAX_OFFSET && offset >= -RTC_MAX_OFFSET)
+                {
+                    ESP_LOGD(TAG, "RTC offset %lld usec, not updating RTC", offset);
+                    continue;
+                }
+
+                restartWindow = false;
+            }
+        }
+
+        // writing the seconds register restarts the countdown chain of the RTC, so write at a full second
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+
+        int64_t wait = 1000000 - tv.tv_usec;
+        if (wait > 2000 * portTICK_PERIOD_MS)
+            vTaskDelay((wait - 1000 * portTICK_PERIOD_MS) / 1000 / portTICK_PERIOD_MS);
+
+        time_t second = tv.tv_sec;
+        do
+        {
+            gettimeofday(&tv, NULL);
+        } while (tv.tv_sec == second);
+
+        _rtc->SetTime(tv);
+
+        if (restartWindow)
+        {
+            _rtcBaseline = esp_timer_get_time();
+            _rtcCorrected = 0;
+        }
+        else
+        {
+            _rtcCorrected += offset;
+        }
+
+        struct tm now;
+        localtime_r(&tv.tv_sec, &now);
+
+        ESP_LOGI(TAG, "Updated RTC to %02d-%02d-%02d %02d:%02d:%02d %s", now.tm_year + 1900, now.tm_mon + 1, now.tm_mday, now.tm_hour, now.tm_min, now.tm_sec, get_tzname(now.tm_isdst));
     }
 }
 
@@ -77,10 +159,32 @@ void SystemClock::stop(void)
     }
 }
 
-void SystemClock::setTime(struct timeval *tv)
+void SystemClock::setTime(struct timeval *tv, clock_source_t source)
 {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t offset = (tv->tv_sec - now.tv_sec) * 1000000LL + (tv->tv_usec - now.tv_usec);
+
+    if (!_selector.addSample(source, offset, esp_timer_get_time()))
+    {
+        ESP_LOGD(TAG, "Ignoring time from %s, offset %lld usec", _sourceNames[source], offset);
+        xSemaphoreGive(_mutex);
+        return;
+    }
+
     settimeofday(tv, NULL);
     _lastSyncTime = *tv;
+    _lastOffset = offset > INT32_MAX ? INT32_MAX : (offset < INT32_MIN ? INT32_MIN : offset);
+
+    if (source != _syncSource)
+    {
+        ESP_LOGI(TAG, "Using %s as time source", _sourceNames[source]);
+        _syncSource = source;
+    }
+
+    xSemaphoreGive(_mutex);
 
     if (_tHandle != NULL)
     {
@@ -100,6 +204,45 @@ struct timeval SystemClock::getLastSyncTime()
     return _lastSyncTime;
 }
 
+clock_source_t SystemClock::getSyncSource()
+{
+    return _syncSource;
+}
+
+int32_t SystemClock::getLastOffset()
+{
+    return _lastOffset;
+}
+
+int32_t SystemClock::getRtcDrift()
+{
+    return _rtcDrift;
+}
+
+int32_t SystemClock::getRtcTrim()
+{
+    return _rtc ? _rtc->GetTrim() : 0;
+}
+
+int32_t SystemClock::getRtcAlignmentError()
+{
+    return _rtcAlignmentError;
+}
+
+uint32_t SystemClock::getJitter()
+{
+    return _selector.getJitter(_syncSource);
+}
+
+bool SystemClock::isSourceAvailable(clock_source_t source)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    bool res = _selector.isAvailable(source, esp_timer_get_time());
+    xSemaphoreGive(_mutex);
+
+    return res;
+}
+
 struct tm SystemClock::getLocalTime(void)
 {
     time_t now;
@@ -0,0 +1,197 @@
+/* 
+ *  telemetry.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+
+#include "telemetry.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "Telemetry";
+
+static const uint16_t _capacities[TELEMETRY_RESOLUTION_COUNT] = {180, 120, 72}; // 3 minutes, 2 hours, 3 days
+static const uint16_t _intervals[TELEMETRY_RESOLUTION_COUNT] = {1, 60, 3600};
+
+void telemetrySamplerTask(void *parameter)
+{
+    ((Telemetry *)parameter)->_samplerTask();
+}
+
+static uint16_t toFixed(uint64_t value)
+{
+    return value > UINT16_MAX ? UINT16_MAX : value;
+}
+
+Telemetry::Telemetry(SysInfo *sysInfo, RawUartUdpListener *rawUartUdpListener, NtpServer *ntpServer, SystemClock *clk) : _sysInfo(sysInfo), _rawUartUdpListener(rawUartUdpListener), _ntpServer(ntpServer), _clk(clk)
+{
+    _mutex = xSemaphoreCreateMutex();
+
+    for (int i = 0; i < TELEMETRY_RESOLUTION_COUNT; i++)
+    {
+        telemetry_ring_t *ring = &_rings[i];
+        memset(ring, 0, sizeof(telemetry_ring_t));
+        ring->samples = (telemetry_sample_t *)calloc(_capacities[i], sizeof(telemetry_sample_t));
+        ring->interval = _intervals[i];
+
+        // a ring without memory stays empty, the other resolutions still work
+        if (ring->samples != NULL)
+            ring->capacity = _capacities[i];
+        else
+            ESP_LOGE(TAG, "Could not allocate history for %d sec resolution", _intervals[i]);
+    }
+}
+
+void Telemetry::start()
+{
+    _lastSample = esp_timer_get_time();
+    _lastFramesToRemote = _rawUartUdpListener->getFramesToRemote();
+    _lastFramesFromRemote = _rawUartUdpListener->getFramesFromRemote();
+    _lastNtpRequests = _ntpServer->getRequestCount();
+
+    xTaskCreate(telemetrySamplerTask, "Telemetry_Sampler", 3072, this, 3, &_tHandle);
+}
+
+void Telemetry::stop()
+{
+    vTaskDelete(_tHandle);
+}
+
+void Telemetry::add(telemetry_ring_t *ring, const telemetry_sample_t *sample, uint32_t time)
+{
+    telemetry_accumulator_t *acc = &ring->acc;
+
+    if (ring->capacity == 0)
+        return;
+
+    if (acc->count == 0)
+    {
+        memset(acc, 0, sizeof(telemetry_accumulator_t));
+        acc->heapFree = UINT32_MAX;
+        acc->heapLargestBlock = UINT32_MAX;
+    }
+
+    acc->cpuUsage += sample->cpuUsage;
+    acc->cpuUsageMax = MAX(acc->cpuUsageMax, sample->cpuUsageMax);
+    acc->framesToRemote += sample->framesToRemote;
+    acc->framesFromRemote += sample->framesFromRemote;
+    acc->ntpRequests += sample->ntpRequests;
+    acc->heapFree = MIN(acc->heapFree, sample->heapFree);
+    acc->heapLargestBlock = MIN(acc->heapLargestBlock, sample->heapLargestBlock);
+    acc->syncOffset += sample->syncOffset;
+    acc->count++;
+
+    if (acc->count < ring->interval)
+        return;
+
+    // averages for rates, extremes for values where the worst case matters
+    telemetry_sample_t *target = &ring->samples[ring->next];
+    target->cpuUsage = acc->cpuUsage / acc->count;
+    target->cpuUsageMax = acc->cpuUsageMax;
+    target->framesToRemote = acc->framesToRemote / acc->count;
+    target->framesFromRemote = acc->framesFromRemote / acc->count;
+    target->ntpRequests = acc->ntpRequests / acc->count;
+    target->reserved = 0;
+    target->heapFree = acc->heapFree;
+    target->heapLargestBlock = acc->heapLargestBlock;
+    target->syncOffset = acc->syncOffset / acc->count;
+
+    ring->next = (ring->next + 1) % ring->capacity;
+    if (ring->count < ring->capacity)
+        ring->count++;
+    ring->lastTime = time;
+    acc->count = 0;
+}
+
+uint16_t Telemetry::getCapacity(int resolution)
+{
+    return _rings[resolution].capacity;
+}
+
+uint16_t Telemetry::getSamples(int resolution, telemetry_sample_t *samples, uint16_t maxCount, uint16_t *interval, uint32_t *lastTime)
+{
+    telemetry_ring_t *ring = &_rings[resolution];
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    uint16_t count = MIN(ring->count, maxCount);
+    uint16_t first = ring->capacity ? (ring->next + ring->capacity - count) % ring->capacity : 0;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        samples[i] = ring->samples[(first + i) % ring->capacity];
+    }
+    *interval = ring->interval;
+    *lastTime = ring->lastTime;
+
+    xSemaphoreGive(_mutex);
+
+    return count;
+}
+
+void Telemetry::_sample(telemetry_sample_t *sample)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - _lastSample;
+    _lastSample = now;
+
+    uint32_t framesToRemote = _rawUartUdpListener->getFramesToRemote();
+    uint32_t framesFromRemote = _rawUartUdpListener->getFramesFromRemote();
+    uint32_t ntpRequests = _ntpServer->getRequestCount();
+
+    if (elapsed <= 0)
+        elapsed = 1;
+
+    sample->cpuUsage = toFixed(_sysInfo->getCpuUsage() * 10 + 0.5);
+    sample->cpuUsageMax = sample->cpuUsage;
+    sample->framesToRemote = toFixed((framesToRemote - _lastFramesToRemote) * 10000000ULL / elapsed);
+    sample->framesFromRemote = toFixed((framesFromRemote - _lastFramesFromRemote) * 10000000ULL / elapsed);
+    sample->ntpRequests = toFixed((ntpRequests - _lastNtpRequests) * 10000000ULL / elapsed);
+    sample->reserved = 0;
+    sample->heapFree = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    sample->heapLargestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    sample->syncOffset = _clk->getLastOffset();
+
+    _lastFramesToRemote = framesToRemote;
+    _lastFramesFromRemote = framesFromRemote;
+    _lastNtpRequests = ntpRequests;
+}
+
+void Telemetry::_samplerTask()
+{
+    telemetry_sample_t sample;
+    TickType_t lastWake = xTaskGetTickCount();
+
+    for (;;)
+    {
+        vTaskDelayUntil(&lastWake, 1000 / portTICK_PERIOD_MS);
+
+        _sample(&sample);
+        uint32_t time = esp_timer_get_time() / 1000000;
+
+        // every resolution is fed with the 1 second samples, so its extremes are exact
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        for (int i = 0; i < TELEMETRY_RESOLUTION_COUNT; i++)
+        {
+            add(&_rings[i], &sample, time);
+        }
+        xSemaphoreGive(_mutex);
+    }
+}
@@ -0,0 +1,138 @@
+/* 
+ *  timesourceselector.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include "timesourceselector.h"
+#include <string.h>
+#include <math.h>
+
+#define PHI 15 // frequency tolerance in ppm, see RFC 5905
+
+typedef struct
+{
+    uint32_t baseError; // usec
+    int64_t timeout;    // usec
+} clock_source_props_t;
+
+static const clock_source_props_t _props[CLOCK_SOURCE_COUNT] = {
+    {.baseError = UINT32_MAX, .timeout = 0},                   // CLOCK_SOURCE_NONE
+    {.baseError = 1000000, .timeout = 0},                      // CLOCK_SOURCE_RTC
+    {.baseError = 20000, .timeout = 3 * 3600 * 1000000LL},     // CLOCK_SOURCE_NTP, polls every hour
+    {.baseError = 10000, .timeout = 10 * 60 * 1000000LL},      // CLOCK_SOURCE_DCF, every minute
+    {.baseError = 20000, .timeout = 15 * 60 * 1000000LL},      // CLOCK_SOURCE_GPS, every 5 minutes
+    {.baseError = 100, .timeout = 5 * 60 * 1000000LL},         // CLOCK_SOURCE_PPS, every minute
+};
+
+TimeSourceSelector::TimeSourceSelector() : _selected(CLOCK_SOURCE_NONE)
+{
+    memset(_sources, 0, sizeof(_sources));
+}
+
+bool TimeSourceSelector::isAvailable(clock_source_t source, int64_t now)
+{
+    clock_source_state_t *state = &_sources[source];
+    return state->sampleCount > 0 && now - state->lastSampleTime < _props[source].timeout;
+}
+
+uint64_t TimeSourceSelector::getDistance(clock_source_t source, int64_t now)
+{
+    if (!isAvailable(source, now))
+        return UINT64_MAX;
+
+    clock_source_state_t *state = &_sources[source];
+    return (uint64_t)_props[source].baseError + state->jitter + (now - state->lastSampleTime) * PHI / 1000000;
+}
+
+uint32_t TimeSourceSelector::getJitter(clock_source_t source)
+{
+    return _sources[source].jitter;
+}
+
+clock_source_t TimeSourceSelector::getSelected()
+{
+    return _selected;
+}
+
+void TimeSourceSelector::_select(int64_t now)
+{
+    clock_source_t best = CLOCK_SOURCE_NONE;
+    uint64_t bestDistance = UINT64_MAX;
+
+    for (int i = CLOCK_SOURCE_NTP; i < CLOCK_SOURCE_COUNT; i++)
+    {
+        uint64_t distance = getDistance((clock_source_t)i, now);
+        if (distance < bestDistance)
+        {
+            best = (clock_source_t)i;
+            bestDistance = distance;
+        }
+    }
+
+    if (best == CLOCK_SOURCE_NONE || best == _selected)
+        return; // keep the current source in holdover
+
+    if (!isAvailable(_selected, now))
+    {
+        // failover or first sync
+        _selected = best;
+    }
+    else if (_sources[best].sampleCount >= 2 && bestDistance * 2 < getDistance(_selected, now))
+    {
+        // switch only to sources with a jitter estimate and a significantly better distance
+        _selected = best;
+    }
+}
+
+bool TimeSourceSelector::addSample(clock_source_t source, int64_t offset, int64_t now)
+{
+    if (source <= CLOCK_SOURCE_RTC || source >= CLOCK_SOURCE_COUNT)
+        return false;
+
+    clock_source_state_t *state = &_sources[source];
+
+    if (isAvailable(source, now))
+    {
+        // exponential average of the squared offset changes like the clock jitter of RFC 5905
+        double diff = offset - state->offset;
+        double jitter = state->jitter;
+        jitter = sqrt(jitter * jitter + (diff * diff - jitter * jitter) / 4);
+        state->jitter = jitter < UINT32_MAX ? (uint32_t)jitter : UINT32_MAX;
+    }
+    else
+    {
+        state->jitter = 0;
+        state->sampleCount = 0;
+    }
+
+    state->offset = offset;
+    state->lastSampleTime = now;
+    state->sampleCount++;
+
+    _select(now);
+
+    if (source != _selected)
+        return false;
+
+    // the system clock will be stepped by offset, keep the other offsets relative to it
+    for (int i = 0; i < CLOCK_SOURCE_COUNT; i++)
+    {
+        _sources[i].offset -= offset;
+    }
+
+    return true;
+}
@@ -24,32 +24,25 @@
 #include "webui.h"
 #include "esp_log.h"
 #include "cJSON.h"
+#include "jsonwriter.h"
+#include "webuibundle.h"
+#include "otapipeline.h"
+#include "reconfigurator.h"
+#include "eventlog.h"
+#include "remotesyslog.h"
+#include "pins.h"
+#include "livestatus.h"
+#include "telemetry.h"
 #include "esp_ota_ops.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "mbedtls/md.h"
 #include "mbedtls/base64.h"
 
 static const char *TAG = "WebUI";
 
-#define EMBED_HANDLER(_uri, _resource, _contentType)                   \
-    extern const char _resource[] asm("_binary_" #_resource "_start"); \
-    extern const size_t _resource##_length asm(#_resource "_length");  \
-    esp_err_t _resource##_handler_func(httpd_req_t *req)               \
-    {                                                                  \
-        httpd_resp_set_type(req, _contentType);                        \
-        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");           \
-        httpd_resp_send(req, _resource, _resource##_length);           \
-        return ESP_OK;                                                 \
-    };                                                                 \
-    httpd_uri_t _resource##_handler = {                                \
-        .uri = _uri,                                                   \
-        .method = HTTP_GET,                                            \
-        .handler = _resource##_handler_func,                           \
-        .user_ctx = NULL};
-
-EMBED_HANDLER("/*", index_html_gz, "text/html")
-EMBED_HANDLER("/main.1e43358e.js", main_1e43358e_js_gz, "application/javascript")
-EMBED_HANDLER("/main.1e43358e.css", main_1e43358e_css_gz, "text/css")
-EMBED_HANDLER("/favicon.26242483.ico", favicon_26242483_ico_gz, "image/x-icon")
+#define CACHE_CONTROL_IMMUTABLE "public, max-age=31536000, immutable"
+#define CACHE_CONTROL_REVALIDATE "no-cache"
 
 static Settings *_settings;
 static LED *_statusLED;
@@ -59,7 +52,41 @@ static Ethernet *_ethernet;
 static RawUartUdpListener *_rawUartUdpListener;
 static RadioModuleConnector *_radioModuleConnector;
 static RadioModuleDetector *_radioModuleDetector;
+static GPS *_gps;
+static DCF *_dcf;
+static SystemClock *_clk;
 static char _token[46];
+static WebUIBundle _bundle;
+static LiveStatus *_liveStatus;
+static Telemetry *_telemetry;
+
+// logs the heap used by a JSON request, enable with esp_log_level_set("WebUI", ESP_LOG_DEBUG).
+// the peak is only known if the request lowered the minimum free heap since boot.
+class HeapProbe
+{
+private:
+    httpd_req_t *_req;
+    size_t _freeBefore;
+    size_t _minimumBefore;
+
+public:
+    HeapProbe(httpd_req_t *req) : _req(req)
+    {
+        _freeBefore = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        _minimumBefore = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    }
+
+    ~HeapProbe()
+    {
+        size_t freeAfter = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        size_t minimumAfter = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+
+        if (minimumAfter < _minimumBefore)
+            ESP_LOGD(TAG, "%s: peak heap %u bytes, %d bytes kept", _req->uri, _freeBefore - minimumAfter, (int)(_freeBefore - freeAfter));
+        else
+            ESP_LOGD(TAG, "%s: peak heap below %u bytes, %d bytes kept", _req->uri, _freeBefore - _minimumBefore, (int)(_freeBefore - freeAfter));
+    }
+};
 
 const char *ip2str(ip4_addr_t addr, ip4_addr_t fallback)
 {
@@ -112,6 +139,8 @@ esp_err_t validate_auth(httpd_req_t *req)
 
 esp_err_t post_login_json_handler_func(httpd_req_t *req)
 {
+    HeapProbe probe(req);
+
     char buffer[1024];
     int len = httpd_req_recv(req, buffer, sizeof(buffer) - 1);
 
@@ -128,20 +157,17 @@ esp_err_t post_login_json_handler_func(httpd_req_t *req)
         cJSON_Delete(root);
 
         httpd_resp_set_type(req, "application/json");
-        root = cJSON_CreateObject();
+        JsonWriter writer(req);
+        writer.beginObject();
 
-        cJSON_AddBoolToObject(root, "isAuthenticated", isAuthenticated);
+        writer.addBool("isAuthenticated", isAuthenticated);
         if (isAuthenticated)
         {
-            cJSON_AddStringToObject(root, "token", _token);
+            writer.addString("token", _token);
         }
 
-        const char *json = cJSON_Print(root);
-        httpd_resp_sendstr(req, json);
-        free((void *)json);
-        cJSON_Delete(root);
-
-        return ESP_OK;
+        writer.endObject();
+        return writer.end();
     }
 
     return ESP_FAIL;
@@ -155,46 +181,69 @@ httpd_uri_t post_login_json_handler = {
 
 esp_err_t get_sysinfo_json_handler_func(httpd_req_t *req)
 {
-    httpd_resp_set_type(req, "application/json");
-    cJSON *root = cJSON_CreateObject();
+    HeapProbe probe(req);
 
-    cJSON *sysinfo = cJSON_AddObjectToObject(root, "sysInfo");
+    httpd_resp_set_type(req, "application/json");
+    JsonWriter writer(req);
+    writer.beginObject();
+    writer.beginObject("sysInfo");
 
-    cJSON_AddStringToObject(sysinfo, "serial", _sysInfo->getSerialNumber());
-    cJSON_AddStringToObject(sysinfo, "currentVersion", _sysInfo->getCurrentVersion());
-    cJSON_AddStringToObject(sysinfo, "latestVersion", _updateCheck->getLatestVersion());
+    writer.addString("serial", _sysInfo->getSerialNumber());
+    writer.addString("currentVersion", _sysInfo->getCurrentVersion());
+    writer.addString("latestVersion", _updateCheck->getLatestVersion());
 
-    cJSON_AddNumberToObject(sysinfo, "memoryUsage", _sysInfo->getMemoryUsage());
-    cJSON_AddNumberToObject(sysinfo, "cpuUsage", _sysInfo->getCpuUsage());
+    writer.addNumber("memoryUsage", _sysInfo->getMemoryUsage());
+    writer.addNumber("cpuUsage", _sysInfo->getCpuUsage());
 
-    cJSON_AddStringToObject(sysinfo, "rawUartRemoteAddress", ip2str(_rawUartUdpListener->getConnectedRemoteAddress()));
+    writer.addString("rawUartRemoteAddress", ip2str(_rawUartUdpListener->getConnectedRemoteAddress()));
 
     switch (_radioModuleDetector->getRadioModuleType())
     {
     case RADIO_MODULE_HM_MOD_RPI_PCB:
-        cJSON_AddStringToObject(sysinfo, "radioModuleType", "HM-MOD-RPI-PCB");
+        writer.addString("radioModuleType", "HM-MOD-RPI-PCB");
         break;
     case RADIO_MODULE_RPI_RF_MOD:
-        cJSON_AddStringToObject(sysinfo, "radioModuleType", "RPI-RF-MOD");
+        writer.addString("radioModuleType", "RPI-RF-MOD");
         break;
     default:
-        cJSON_AddStringToObject(sysinfo, "radioModuleType", "-");
+        writer.addString("radioModuleType", "-");
         break;
     }
-    cJSON_AddStringToObject(sysinfo, "radioModuleSerial", _radioModuleDetector->getSerial());
+    writer.addString("radioModuleSerial", _radioModuleDetector->getSerial());
     char radioMAC[9];
     formatRadioMAC(_radioModuleDetector->getBidCosRadioMAC(), radioMAC);
-    cJSON_AddStringToObject(sysinfo, "radioModuleBidCosRadioMAC", radioMAC);
+    writer.addString("radioModuleBidCosRadioMAC", radioMAC);
     formatRadioMAC(_radioModuleDetector->getHmIPRadioMAC(), radioMAC);
-    cJSON_AddStringToObject(sysinfo, "radioModuleHmIPRadioMAC", radioMAC);
-    cJSON_AddStringToObject(sysinfo, "radioModuleSGTIN", _radioModuleDetector->getSGTIN());
+    writer.addString("radioModuleHmIPRadioMAC", radioMAC);
+    writer.addString("radioModuleSGTIN", _radioModuleDetector->getSGTIN());
 
-    const char *json = cJSON_Print(root);
-    httpd_resp_sendstr(req, json);
-    free((void *)json);
-    cJSON_Delete(root);
+    writer.addNumber("rtcAlignmentError", _clk->getRtcAlignmentError());
+    writer.addNumber("rtcDrift", _clk->getRtcDrift());
+    writer.addNumber("rtcTrim", _clk->getRtcTrim());
 
-    return ESP_OK;
+    writer.addNumber("ledAvoidedWakeups", LED::getAvoidedWakeups());
+    writer.addNumber("ledAvoidedRegisterWrites", LED::getAvoidedRegisterWrites());
+
+    writer.addNumber("gpsWakeupsPerSecond", _gps->getWakeupsPerSecond());
+    writer.addNumber("dcfInterruptsPerMinute", _dcf->getInterruptsPerMinute());
+    writer.addNumber("dcfCpuTimePerMinute", _dcf->getCpuTimePerMinute());
+    writer.addBool("dcfCalibrating", _dcf->isCalibrating());
+    writer.addNumber("dcfCalibrationSamples", _dcf->getCalibrationSampleCount());
+    writer.addNumber("dcfCalibrationDeviation", _dcf->getCalibrationDeviation());
+
+    writer.addNumber("syslogDropped", RemoteSyslog::getDroppedCount());
+    writer.addNumber("liveStatusSubscribers", _liveStatus->getSubscriberCount());
+
+    writer.beginObject("reconfigureOutages");
+    for (int kind = 0; kind < RECONFIGURE_COUNT; kind++)
+    {
+        writer.addNumber(Reconfigurator::kindNames[kind], Reconfigurator::getLastOutage((reconfigure_kind_t)kind));
+    }
+    writer.endObject();
+
+    writer.endObject();
+    writer.endObject();
+    return writer.end();
 }
 
 httpd_uri_t get_sysinfo_json_handler = {
@@ -203,35 +252,335 @@ httpd_uri_t get_sysinfo_json_handler = {
     .handler = get_sysinfo_json_handler_func,
     .user_ctx = NULL};
 
-void add_settings(cJSON *root)
+esp_err_t get_status_ws_handler_func(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET)
+    {
+        // handshake completed, the connection now receives the live status
+        return _liveStatus->subscribe(req);
+    }
+
+    // clients do not send anything meaningful, read and discard the payload
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK || frame.len == 0)
+        return err;
+
+    if (frame.len > 128)
+        return ESP_FAIL;
+
+    uint8_t payload[128];
+    frame.payload = payload;
+    return httpd_ws_recv_frame(req, &frame, frame.len);
+}
+
+httpd_uri_t get_status_ws_handler = {
+    .uri = "/status",
+    .method = HTTP_GET,
+    .handler = get_status_ws_handler_func,
+    .user_ctx = NULL,
+    .is_websocket = true};
+
+#define ADD_SERIES(name, value)         \
+    writer.beginArray(name);            \
+    for (int i = 0; i < count; i++)     \
+    {                                   \
+        writer.addNumber(NULL, value);  \
+    }                                   \
+    writer.endArray()
+
+esp_err_t get_history_json_handler_func(httpd_req_t *req)
+{
+    static const char *resolutionNames[TELEMETRY_RESOLUTION_COUNT] = {"seconds", "minutes", "hours"};
+
+    uint16_t maxCount = 0;
+    for (int r = 0; r < TELEMETRY_RESOLUTION_COUNT; r++)
+    {
+        maxCount = MAX(maxCount, _telemetry->getCapacity(r));
+    }
+
+    telemetry_sample_t *samples = (telemetry_sample_t *)malloc(maxCount * sizeof(telemetry_sample_t));
+    if (samples == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    JsonWriter writer(req);
+    writer.beginObject();
+    writer.beginObject("history");
+    writer.addNumber("uptime", esp_timer_get_time() / 1000000);
+
+    // one array per value, oldest sample first, the newest one ends at lastTime (uptime in sec)
+    for (int r = 0; r < TELEMETRY_RESOLUTION_COUNT; r++)
+    {
+        uint16_t interval;
+        uint32_t lastTime;
+        int count = _telemetry->getSamples(r, samples, maxCount, &interval, &lastTime);
+
+        writer.beginObject(resolutionNames[r]);
+        writer.addNumber("interval", interval);
+        writer.addNumber("lastTime", lastTime);
+        ADD_SERIES("cpuUsage", samples[i].cpuUsage / 10.0);
+        ADD_SERIES("cpuUsageMax", samples[i].cpuUsageMax / 10.0);
+        ADD_SERIES("heapFree", samples[i].heapFree);
+        ADD_SERIES("heapLargestBlock", samples[i].heapLargestBlock);
+        ADD_SERIES("rawUartFramesToRemote", samples[i].framesToRemote / 10.0);
+        ADD_SERIES("rawUartFramesFromRemote", samples[i].framesFromRemote / 10.0);
+        ADD_SERIES("ntpRequests", samples[i].ntpRequests / 10.0);
+        ADD_SERIES("syncOffset", samples[i].syncOffset);
+        writer.endObject();
+    }
+
+    writer.endObject();
+    writer.endObject();
+
+    free(samples);
+
+    return writer.end();
+}
+
+httpd_uri_t get_history_json_handler = {
+    .uri = "/history.json",
+    .method = HTTP_GET,
+    .handler = get_history_json_handler_func,
+    .user_ctx = NULL};
+
+esp_err_t get_profiler_json_handler_func(httpd_req_t *req)
+{
+    HeapProbe probe(req);
+
+    Profiler *profiler = _sysInfo->getProfiler();
+
+    profiler_task_t *tasks = (profiler_task_t *)malloc(PROFILER_MAX_TASKS * sizeof(profiler_task_t));
+    if (tasks == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+
+    uint8_t taskCount = profiler->getTasks(tasks, PROFILER_MAX_TASKS);
+    profiler_isr_t isrs[PROFILER_MAX_ISRS];
+    uint8_t isrCount = profiler->getIsrs(isrs, PROFILER_MAX_ISRS);
+
+    httpd_resp_set_type(req, "application/json");
+    JsonWriter writer(req);
+    writer.beginObject();
+    writer.beginObject("profiler");
+
+    writer.beginArray("windows");
+    for (int w = 0; w < PROFILER_WINDOW_COUNT; w++)
+    {
+        writer.addString(NULL, Profiler::windowNames[w]);
+    }
+    writer.endArray();
+
+    writer.beginArray("cores");
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        float load[PROFILER_WINDOW_COUNT];
+        for (int w = 0; w < PROFILER_WINDOW_COUNT; w++)
+        {
+            load[w] = profiler->getCoreLoad(core, w);
+        }
+
+        writer.beginObject();
+        writer.addNumber("core", core);
+        writer.addNumberArray("load", load, PROFILER_WINDOW_COUNT);
+        writer.endObject();
+    }
+    writer.endArray();
+
+    writer.beginArray("tasks");
+    for (uint8_t i = 0; i < taskCount; i++)
+    {
+        writer.beginObject();
+        writer.addString("name", tasks[i].name);
+        writer.addNumber("core", tasks[i].core);
+        writer.addNumber("priority", tasks[i].priority);
+        writer.addNumber("stackHighWaterMark", tasks[i].stackHighWaterMark);
+        writer.addNumberArray("load", tasks[i].load, PROFILER_WINDOW_COUNT);
+        writer.endObject();
+    }
+    writer.endArray();
+
+    writer.beginArray("isrs");
+    for (uint8_t i = 0; i < isrCount; i++)
+    {
+        writer.beginObject();
+        writer.addString("name", isrs[i].name);
+        writer.addNumberArray("rate", isrs[i].rate, PROFILER_WINDOW_COUNT);
+        writer.addNumberArray("load", isrs[i].load, PROFILER_WINDOW_COUNT);
+        writer.endObject();
+    }
+    writer.endArray();
+
+    free(tasks);
+
+    writer.endObject();
+    writer.endObject();
+    return writer.end();
+}
+
+httpd_uri_t get_profiler_json_handler = {
+    .uri = "/profiler.json",
+    .method = HTTP_GET,
+    .handler = get_profiler_json_handler_func,
+    .user_ctx = NULL};
+
+esp_err_t get_metrics_handler_func(httpd_req_t *req)
+{
+    HeapProbe probe(req);
+
+    Profiler *profiler = _sysInfo->getProfiler();
+
+    profiler_task_t *tasks = (profiler_task_t *)malloc(PROFILER_MAX_TASKS * sizeof(profiler_task_t));
+    if (tasks == NULL)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+
+    uint8_t taskCount = profiler->getTasks(tasks, PROFILER_MAX_TASKS);
+    profiler_isr_t isrs[PROFILER_MAX_ISRS];
+    uint8_t isrCount = profiler->getIsrs(isrs, PROFILER_MAX_ISRS);
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    ChunkedWriter writer(req);
+
+    writer.printf("# HELP hbrfeth_core_load_percent CPU load of a core\n# TYPE hbrfeth_core_load_percent gauge\n");
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        for (int w = 0; w < PROFILER_WINDOW_COUNT; w++)
+        {
+            writer.printf("hbrfeth_core_load_percent{core=\"%d\",window=\"%s\"} %.2f\n", core, Profiler::windowNames[w], profiler->getCoreLoad(core, w));
+        }
+    }
+
+    writer.printf("# HELP hbrfeth_task_load_percent CPU load of a task in percent of one core\n# TYPE hbrfeth_task_load_percent gauge\n");
+    for (uint8_t i = 0; i < taskCount; i++)
+    {
+        for (int w = 0; w < PROFILER_WINDOW_COUNT; w++)
+        {
+            writer.printf("hbrfeth_task_load_percent{task=\"%s\",core=\"%d\",window=\"%s\"} %.2f\n", tasks[i].name, tasks[i].core, Profiler::windowNames[w], tasks[i].load[w]);
+        }
+    }
+
+    writer.printf("# HELP hbrfeth_task_stack_free_bytes Minimum free stack of a task since its start\n# TYPE hbrfeth_task_stack_free_bytes gauge\n");
+    for (uint8_t i = 0; i < taskCount; i++)
+    {
+        writer.printf("hbrfeth_task_stack_free_bytes{task=\"%s\"} %u\n", tasks[i].name, tasks[i].stackHighWaterMark);
+    }
+
+    writer.printf("# HELP hbrfeth_isr_rate Interrupts per second\n# TYPE hbrfeth_isr_rate gauge\n");
+    for (uint8_t i = 0; i < isrCount; i++)
+    {
+        for (int w = 0; w < PROFILER_WINDOW_COUNT; w++)
+        {
+            writer.printf("hbrfeth_isr_rate{isr=\"%s\",window=\"%s\"} %.2f\n", isrs[i].name, Profiler::windowNames[w], isrs[i].rate[w]);
+        }
+    }
+
+    writer.printf("# HELP hbrfeth_isr_load_percent CPU time spent in interrupt handlers in percent of one core\n# TYPE hbrfeth_isr_load_percent gauge\n");
+    for (uint8_t i = 0; i < isrCount; i++)
+    {
+        for (int w = 0; w < PROFILER_WINDOW_COUNT; w++)
+        {
+            writer.printf("hbrfeth_isr_load_percent{isr=\"%s\",window=\"%s\"} %.4f\n", isrs[i].name, Profiler::windowNames[w], isrs[i].load[w]);
+        }
+    }
+
+    free(tasks);
+
+    return writer.end();
+}
+
+httpd_uri_t get_metrics_handler = {
+    .uri = "/metrics",
+    .method = HTTP_GET,
+    .handler = get_metrics_handler_func,
+    .user_ctx = NULL};
+
+esp_err_t get_log_handler_func(httpd_req_t *req)
 {
-    cJSON *settings = cJSON_AddObjectToObject(root, "settings");
+    if (validate_auth(req) != ESP_OK)
+    {
+        httpd_resp_set_status(req, "401 Not authorized");
+        httpd_resp_sendstr(req, "401 Not authorized");
+        return ESP_OK;
+    }
+
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"hb-rf-eth.log\"");
+    ChunkedWriter writer(req);
+
+    // records overwritten while sending are skipped
+    eventlog_record_t record;
+    char line[160];
+    uint32_t next = EventLog::getNextSeq();
+    for (uint32_t seq = EventLog::getFirstSeq(); seq != next; seq++)
+    {
+        if (!EventLog::read(seq, &record))
+            continue;
+
+        EventLog::format(&record, line, sizeof(line));
+        writer.write(line);
+        writer.write("\n");
+    }
 
-    cJSON_AddStringToObject(settings, "hostname", _settings->getHostname());
+    writer.printf("# %u records suppressed by rate limit\n", (unsigned int)EventLog::getDroppedCount());
 
-    cJSON_AddBoolToObject(settings, "useDHCP", _settings->getUseDHCP());
+    return writer.end();
+}
+
+httpd_uri_t get_log_handler = {
+    .uri = "/log.txt",
+    .method = HTTP_GET,
+    .handler = get_log_handler_func,
+    .user_ctx = NULL};
+
+void add_settings(JsonWriter *writer)
+{
+    writer->beginObject("settings");
+
+    writer->addString("hostname", _settings->getHostname());
+
+    writer->addBool("useDHCP", _settings->getUseDHCP());
 
     ip4_addr_t currentIP, currentNetmask, currentGateway, currentDNS1, currentDNS2;
     _ethernet->getNetworkSettings(&currentIP, &currentNetmask, &currentGateway, &currentDNS1, &currentDNS2);
-    cJSON_AddStringToObject(settings, "localIP", ip2str(_settings->getLocalIP(), currentIP));
-    cJSON_AddStringToObject(settings, "netmask", ip2str(_settings->getNetmask(), currentNetmask));
-    cJSON_AddStringToObject(settings, "gateway", ip2str(_settings->getGateway(), currentGateway));
-    cJSON_AddStringToObject(settings, "dns1", ip2str(_settings->getDns1(), currentDNS1));
-    cJSON_AddStringToObject(settings, "dns2", ip2str(_settings->getDns2(), currentDNS2));
+    writer->addString("localIP", ip2str(_settings->getLocalIP(), currentIP));
+    writer->addString("netmask", ip2str(_settings->getNetmask(), currentNetmask));
+    writer->addString("gateway", ip2str(_settings->getGateway(), currentGateway));
+    writer->addString("dns1", ip2str(_settings->getDns1(), currentDNS1));
+    writer->addString("dns2", ip2str(_settings->getDns2(), currentDNS2));
+
+    writer->addNumber("timesources", _settings->getTimesources());
+
+    writer->addNumber("dcfOffset", _settings->getDcfOffset());
+    writer->addBool("dcfCalibration", _settings->getDcfCalibration());
+
+    writer->addNumber("gpsBaudrate", _settings->getGpsBaudrate());
+    writer->addNumber("gpsPpsPin", _settings->getGpsPpsPin());
 
-    cJSON_AddNumberToObject(settings, "timesource", _settings->getTimesource());
+    writer->addString("ntpServer", _settings->getNtpServer());
 
-    cJSON_AddNumberToObject(settings, "dcfOffset", _settings->getDcfOffset());
+    writer->addNumber("ledBrightness", _settings->getLEDBrightness());
 
-    cJSON_AddNumberToObject(settings, "gpsBaudrate", _settings->getGpsBaudrate());
+    writer->addString("syslogServer", _settings->getSyslogServer());
+    writer->addNumber("syslogLevel", _settings->getSyslogLevel());
 
-    cJSON_AddStringToObject(settings, "ntpServer", _settings->getNtpServer());
+    writer->addNumber("liveStatusInterval", _settings->getLiveStatusInterval());
 
-    cJSON_AddNumberToObject(settings, "ledBrightness", _settings->getLEDBrightness());
+    writer->endObject();
 }
 
 esp_err_t get_settings_json_handler_func(httpd_req_t *req)
 {
+    HeapProbe probe(req);
+
     if (validate_auth(req) != ESP_OK)
     {
         httpd_resp_set_status(req, "401 Not authorized");
@@ -240,16 +589,12 @@ esp_err_t get_settings_json_handler_func(httpd_req_t *req)
     }
 
     httpd_resp_set_type(req, "application/json");
-    cJSON *root = cJSON_CreateObject();
-
-    add_settings(root);
+    JsonWriter writer(req);
+    writer.beginObject();
+    add_settings(&writer);
+    writer.endObject();
 
-    const char *json = cJSON_Print(root);
-    httpd_resp_sendstr(req, json);
-    free((void *)json);
-    cJSON_Delete(root);
-
-    return ESP_OK;
+    return writer.end();
 }
 
 httpd_uri_t get_settings_json_handler = {
@@ -258,30 +603,44 @@ httpd_uri_t get_settings_json_handler = {
     .handler = get_settings_json_handler_func,
     .user_ctx = NULL};
 
-ip4_addr_t cJSON_GetIPAddrValue(const cJSON *item)
+ip4_addr_t cJSON_GetIPAddrValue(const cJSON *item, ip4_addr_t fallback)
 {
     ip4_addr_t res{.addr = IPADDR_ANY};
 
     if (cJSON_IsString(item))
     {
+        // an empty or invalid address clears the setting
         ip4addr_aton(item->valuestring, &res);
+        return res;
     }
 
-    return res;
+    return fallback;
 }
 
-bool cJSON_GetBoolValue(const cJSON *item)
+bool cJSON_GetBoolValue(const cJSON *item, bool fallback)
 {
     if (cJSON_IsBool(item))
     {
         return item->type == cJSON_True;
     }
 
-    return false;
+    return fallback;
+}
+
+int cJSON_GetIntValue(const cJSON *item, int fallback)
+{
+    if (cJSON_IsNumber(item))
+    {
+        return item->valueint;
+    }
+
+    return fallback;
 }
 
 esp_err_t post_settings_json_handler_func(httpd_req_t *req)
 {
+    HeapProbe probe(req);
+
     if (validate_auth(req) != ESP_OK)
     {
         httpd_resp_set_status(req, "401 Not authorized");
@@ -300,48 +659,65 @@ esp_err_t post_settings_json_handler_func(httpd_req_t *req)
         char *adminPassword = cJSON_GetStringValue(cJSON_GetObjectItem(root, "adminPassword"));
 
         char *hostname = cJSON_GetStringValue(cJSON_GetObjectItem(root, "hostname"));
-        bool useDHCP = cJSON_GetBoolValue(cJSON_GetObjectItem(root, "useDHCP"));
-        ip4_addr_t localIP = cJSON_GetIPAddrValue(cJSON_GetObjectItem(root, "localIP"));
-        ip4_addr_t netmask = cJSON_GetIPAddrValue(cJSON_GetObjectItem(root, "netmask"));
-        ip4_addr_t gateway = cJSON_GetIPAddrValue(cJSON_GetObjectItem(root, "gateway"));
-        ip4_addr_t dns1 = cJSON_GetIPAddrValue(cJSON_GetObjectItem(root, "dns1"));
-        ip4_addr_t dns2 = cJSON_GetIPAddrValue(cJSON_GetObjectItem(root, "dns2"));
+        bool useDHCP = cJSON_GetBoolValue(cJSON_GetObjectItem(root, "useDHCP"), _settings->getUseDHCP());
+        ip4_addr_t localIP = cJSON_GetIPAddrValue(cJSON_GetObjectItem(root, "localIP"), _settings->getLocalIP());
+        ip4_addr_t netmask = cJSON_GetIPAddrValue(cJSON_GetObjectItem(root, "netmask"), _settings->getNetmask());
+        ip4_addr_t gateway = cJSON_GetIPAddrValue(cJSON_GetObjectItem(root, "gateway"), _settings->getGateway());
+        ip4_addr_t dns1 = cJSON_GetIPAddrValue(cJSON_GetObjectItem(root, "dns1"), _settings->getDns1());
+        ip4_addr_t dns2 = cJSON_GetIPAddrValue(cJSON_GetObjectItem(root, "dns2"), _settings->getDns2());
 
-        timesource_t timesource = (timesource_t)cJSON_GetObjectItem(root, "timesource")->valueint;
+        int timesources = cJSON_GetIntValue(cJSON_GetObjectItem(root, "timesources"), _settings->getTimesources());
 
-        int dcfOffset = cJSON_GetObjectItem(root, "dcfOffset")->valueint;
+        int dcfOffset = cJSON_GetIntValue(cJSON_GetObjectItem(root, "dcfOffset"), _settings->getDcfOffset());
+        bool dcfCalibration = cJSON_GetBoolValue(cJSON_GetObjectItem(root, "dcfCalibration"), _settings->getDcfCalibration());
 
-        int gpsBaudrate = cJSON_GetObjectItem(root, "gpsBaudrate")->valueint;
+        int gpsBaudrate = cJSON_GetIntValue(cJSON_GetObjectItem(root, "gpsBaudrate"), _settings->getGpsBaudrate());
+        int gpsPpsPin = cJSON_GetIntValue(cJSON_GetObjectItem(root, "gpsPpsPin"), _settings->getGpsPpsPin());
 
         char *ntpServer = cJSON_GetStringValue(cJSON_GetObjectItem(root, "ntpServer"));
 
-        int ledBrightness = cJSON_GetObjectItem(root, "ledBrightness")->valueint;
+        int ledBrightness = cJSON_GetIntValue(cJSON_GetObjectItem(root, "ledBrightness"), _settings->getLEDBrightness());
+
+        char *syslogServer = cJSON_GetStringValue(cJSON_GetObjectItem(root, "syslogServer"));
+        int syslogLevel = cJSON_GetIntValue(cJSON_GetObjectItem(root, "syslogLevel"), _settings->getSyslogLevel());
+
+        int liveStatusInterval = cJSON_GetIntValue(cJSON_GetObjectItem(root, "liveStatusInterval"), _settings->getLiveStatusInterval());
+
+        if (!isValidGpsPpsPin(gpsPpsPin))
+        {
+            cJSON_Delete(root);
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid GPS PPS pin");
+            return ESP_FAIL;
+        }
 
         if (adminPassword && strlen(adminPassword) > 0)
             _settings->setAdminPassword(adminPassword);
 
         _settings->setNetworkSettings(hostname, useDHCP, localIP, netmask, gateway, dns1, dns2);
-        _settings->setTimesource(timesource);
+        _settings->setTimesources(timesources);
         _settings->setDcfOffset(dcfOffset);
+        _settings->setDcfCalibration(dcfCalibration);
         _settings->setGpsBaudrate(gpsBaudrate);
+        _settings->setGpsPpsPin(gpsPpsPin);
         _settings->setNtpServer(ntpServer);
         _settings->setLEDBrightness(ledBrightness);
+        if (syslogServer)
+            _settings->setSyslogServer(syslogServer);
+        _settings->setSyslogLevel(syslogLevel);
+        _settings->setLiveStatusInterval(liveStatusInterval);
 
-        _settings->save();
+        // only changed keys are written, repeated posts within the commit delay are coalesced
+        _settings->saveDeferred();
 
         cJSON_Delete(root);
 
         httpd_resp_set_type(req, "application/json");
-        root = cJSON_CreateObject();
-
-        add_settings(root);
+        JsonWriter writer(req);
+        writer.beginObject();
+        add_settings(&writer);
+        writer.endObject();
 
-        const char *json = cJSON_Print(root);
-        httpd_resp_sendstr(req, json);
-        free((void *)json);
-        cJSON_Delete(root);
-
-        return ESP_OK;
+        return writer.end();
     }
 
     return ESP_FAIL;
@@ -364,6 +740,34 @@ httpd_uri_t post_settings_json_handler = {
         }                                                                         \
     } while (0)
 
+static bool parse_sha256(const char *hex, uint8_t *sha256)
+{
+    if (strlen(hex) != 64)
+        return false;
+
+    for (int i = 0; i < 32; i++)
+    {
+        unsigned int value;
+        if (sscanf(hex + 2 * i, "%2x", &value) != 1)
+            return false;
+        sha256[i] = value;
+    }
+
+    return true;
+}
+
+#define MULTIPART_TRAILER_MAX 80 // "\r\n--", a boundary of at most 70 characters and "--\r\n"
+
+static char *find_last(char *buffer, size_t length, const char *needle, size_t needle_length)
+{
+    for (size_t pos = length; pos >= needle_length; pos--)
+    {
+        if (memcmp(buffer + pos - needle_length, needle, needle_length) == 0)
+            return buffer + pos - needle_length;
+    }
+    return NULL;
+}
+
 esp_err_t post_ota_update_handler_func(httpd_req_t *req)
 {
     if (validate_auth(req) != ESP_OK)
@@ -373,56 +777,97 @@ esp_err_t post_ota_update_handler_func(httpd_req_t *req)
         return ESP_OK;
     }
 
-    esp_ota_handle_t ota_handle;
+    OtaPipeline pipeline(&_bundle);
+    int remaining = req->content_len;
+    bool is_first_buffer = true;
+    char *buffer;
+    size_t buffer_size;
+    size_t buffer_len;
+    char message[100];
+
+    char content_type[64] = {0};
+    httpd_req_get_hdr_value_str(req, "Content-Type", content_type, sizeof(content_type));
+    bool is_multipart = strncmp(content_type, "multipart/form-data", 19) == 0;
+    char delimiter[MULTIPART_TRAILER_MAX] = "\r\n";
+    size_t delimiter_len = 0;
+
+    char sha256_hex[65] = {0};
+    uint8_t sha256[32];
+    bool has_sha256 = httpd_req_get_hdr_value_str(req, "X-SHA256", sha256_hex, sizeof(sha256_hex)) == ESP_OK;
+    OTA_CHECK(!has_sha256 || parse_sha256(sha256_hex, sha256), "Invalid SHA-256");
+
+    // size is only known exactly for raw uploads
+    OTA_CHECK(pipeline.begin(is_multipart ? 0 : remaining) == ESP_OK, "Could not start OTA");
+    _statusLED->setState(LED_STATE_BLINK_FAST);
+
+    // receive into one buffer while the other one is written to flash
+    while (remaining > 0)
+    {
+        buffer = pipeline.getBuffer(&buffer_size);
+        buffer_len = 0;
 
-    char ota_buff[1024];
-    int content_length = req->content_len;
-    int content_received = 0;
-    int recv_len;
-    bool is_req_body_started = false;
-    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+        // the last buffer of a multipart upload has to contain the whole closing delimiter
+        size_t buffer_limit = buffer_size;
+        if (is_multipart && remaining > MULTIPART_TRAILER_MAX)
+            buffer_limit = MIN(buffer_size, (size_t)(remaining - MULTIPART_TRAILER_MAX));
 
-    do
-    {
-        if ((recv_len = httpd_req_recv(req, ota_buff, MIN(content_length, sizeof(ota_buff)))) < 0)
+        while (buffer_len < buffer_limit && remaining > 0)
         {
-            if (recv_len != HTTPD_SOCK_ERR_TIMEOUT)
-            {
-                ESP_LOGE(TAG, "OTA socket Error %d", recv_len);
-                return ESP_FAIL;
-            }
+            int recv_len = httpd_req_recv(req, buffer + buffer_len, MIN(remaining, buffer_limit - buffer_len));
+            if (recv_len == HTTPD_SOCK_ERR_TIMEOUT)
+                continue;
+
+            OTA_CHECK(recv_len > 0, "OTA socket Error");
+            buffer_len += recv_len;
+            remaining -= recv_len;
         }
 
-        if (!is_req_body_started)
+        if (is_first_buffer && is_multipart)
         {
-            is_req_body_started = true;
-
-            char *body_start_p = strstr(ota_buff, "\r\n\r\n") + 4;
-            int body_part_len = recv_len - (body_start_p - ota_buff);
-
-            OTA_CHECK(esp_ota_begin(update_partition, OTA_SIZE_UNKNOWN, &ota_handle) == ESP_OK, "Could not start OTA");
-            ESP_LOGW(TAG, "Begin OTA Update to partition %s, File Size: %d", update_partition->label, content_length);
-            _statusLED->setState(LED_STATE_BLINK_FAST);
-
-            OTA_CHECK(esp_ota_write(ota_handle, body_start_p, body_part_len) == ESP_OK, "Error writing OTA");
+            // the part starts with "--boundary", the body ends before "\r\n--boundary"
+            char *line_end_p = (char *)memmem(buffer, buffer_len, "\r\n", 2);
+            OTA_CHECK(line_end_p != NULL && line_end_p - buffer > 2 && line_end_p - buffer <= MULTIPART_TRAILER_MAX - 6 && strncmp(buffer, "--", 2) == 0, "Invalid multipart upload");
+            delimiter_len = line_end_p - buffer + 2;
+            memcpy(delimiter + 2, buffer, delimiter_len - 2);
+
+            char *body_start_p = (char *)memmem(buffer, buffer_len, "\r\n\r\n", 4);
+            OTA_CHECK(body_start_p != NULL, "Invalid multipart upload");
+            body_start_p += 4;
+            buffer_len -= body_start_p - buffer;
+            memmove(buffer, body_start_p, buffer_len);
         }
-        else
+        is_first_buffer = false;
+
+        if (remaining == 0 && is_multipart)
         {
-            OTA_CHECK(esp_ota_write(ota_handle, ota_buff, recv_len) == ESP_OK, "Error writing OTA");
-            content_received += recv_len;
+            // neither the closing delimiter nor the line break before it belong to the uploaded file
+            char *body_end_p = find_last(buffer, buffer_len, delimiter, delimiter_len);
+            OTA_CHECK(body_end_p != NULL, "Invalid multipart upload");
+            buffer_len = body_end_p - buffer;
         }
-    } while ((recv_len > 0) && (content_received < content_length));
 
-    OTA_CHECK(esp_ota_end(ota_handle) == ESP_OK, "Error writing OTA");
-    OTA_CHECK(esp_ota_set_boot_partition(update_partition) == ESP_OK, "Error writing OTA");
+        OTA_CHECK(pipeline.commit(buffer, buffer_len) == ESP_OK, "Error writing OTA");
+    }
+
+    OTA_CHECK(pipeline.end(has_sha256 ? sha256 : NULL) == ESP_OK, "Error writing OTA");
 
-    ESP_LOGI(TAG, "OTA finished, please restart to activate new firmware.");
-    httpd_resp_sendstr(req, "Firmware update completed, please restart to activate new firmware.");
+    if (pipeline.isWebUIBundle())
+    {
+        ESP_LOGI(TAG, "Web UI update finished.");
+        snprintf(message, sizeof(message), "Web UI update completed (%.2f MB/s).", pipeline.getThroughput());
+    }
+    else
+    {
+        ESP_LOGI(TAG, "OTA finished, please restart to activate new firmware.");
+        snprintf(message, sizeof(message), "Firmware update completed (%.2f MB/s), please restart to activate new firmware.", pipeline.getThroughput());
+    }
+    httpd_resp_sendstr(req, message);
 
     _statusLED->setState(LED_STATE_OFF);
     return ESP_OK;
 
 err:
+    pipeline.abort();
     _statusLED->setState(LED_STATE_OFF);
     return ESP_FAIL;
 }
@@ -433,7 +878,71 @@ httpd_uri_t post_ota_update_handler = {
     .handler = post_ota_update_handler_func,
     .user_ctx = NULL};
 
-WebUI::WebUI(Settings *settings, LED *statusLED, SysInfo *sysInfo, UpdateCheck *updateCheck, Ethernet *ethernet, RawUartUdpListener *rawUartUdpListener, RadioModuleConnector *radioModuleConnector, RadioModuleDetector *radioModuleDetector)
+// served as long as no web UI bundle is installed in the spiffs partition
+static const char _fallbackPage[] =
+    "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><title>HB-RF-ETH</title></head><body>"
+    "<h3>HB-RF-ETH</h3><p>The web UI is not installed. Please upload webui.bin.</p>"
+    "<p><input id=\"p\" type=\"password\" placeholder=\"Password\"> <input id=\"f\" type=\"file\" accept=\".bin\"> <button onclick=\"u()\">Upload</button></p><p id=\"s\"></p>"
+    "<script>function u(){var s=document.getElementById('s');"
+    "fetch('/login.json',{method:'POST',body:JSON.stringify({password:document.getElementById('p').value})}).then(r=>r.json()).then(l=>{"
+    "if(!l.isAuthenticated)throw 'Login failed';var d=new FormData();d.append('file',document.getElementById('f').files[0]);"
+    "return fetch('/ota_update',{method:'POST',headers:{Authorization:'Token '+l.token},body:d})}).then(r=>{if(!r.ok)throw 'Upload failed';location.reload()})"
+    ".catch(e=>{s.innerText=e})}</script></body></html>";
+
+esp_err_t get_webui_handler_func(httpd_req_t *req)
+{
+    size_t pathLength = strcspn(req->uri, "?#");
+
+    const webui_bundle_entry_t *entry = _bundle.find(req->uri, pathLength);
+    if (entry == NULL)
+    {
+        // unknown paths are routes of the single page app
+        entry = _bundle.find("/index.html", 11);
+    }
+
+    if (entry == NULL)
+    {
+        httpd_resp_set_type(req, "text/html");
+        httpd_resp_set_hdr(req, "Cache-Control", CACHE_CONTROL_REVALIDATE);
+        return httpd_resp_send(req, _fallbackPage, sizeof(_fallbackPage) - 1);
+    }
+
+    if (entry->flags & WEBUI_BUNDLE_FLAG_IMMUTABLE)
+    {
+        httpd_resp_set_hdr(req, "Cache-Control", CACHE_CONTROL_IMMUTABLE);
+    }
+    else
+    {
+        httpd_resp_set_hdr(req, "Cache-Control", CACHE_CONTROL_REVALIDATE);
+        httpd_resp_set_hdr(req, "ETag", _bundle.getETag());
+
+        char ifNoneMatch[64];
+        if (httpd_req_get_hdr_value_str(req, "If-None-Match", ifNoneMatch, sizeof(ifNoneMatch)) == ESP_OK && strstr(ifNoneMatch, _bundle.getETag()) != NULL)
+        {
+            httpd_resp_set_status(req, "304 Not Modified");
+            return httpd_resp_send(req, NULL, 0);
+        }
+    }
+
+    char contentType[sizeof(entry->contentType) + 1];
+    strlcpy(contentType, entry->contentType, sizeof(contentType));
+    httpd_resp_set_type(req, contentType);
+    if (entry->flags & WEBUI_BUNDLE_FLAG_GZIP)
+    {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    }
+
+    // sent directly from the memory mapped flash, no copy into RAM
+    return httpd_resp_send(req, _bundle.getData(entry), entry->length);
+}
+
+httpd_uri_t get_webui_handler = {
+    .uri = "/*",
+    .method = HTTP_GET,
+    .handler = get_webui_handler_func,
+    .user_ctx = NULL};
+
+WebUI::WebUI(Settings *settings, LED *statusLED, SysInfo *sysInfo, UpdateCheck *updateCheck, Ethernet *ethernet, RawUartUdpListener *rawUartUdpListener, RadioModuleConnector *radioModuleConnector, RadioModuleDetector *radioModuleDetector, GPS *gps, DCF *dcf, SystemClock *clk, Telemetry *telemetry)
 {
     _settings = settings;
     _statusLED = statusLED;
@@ -443,6 +952,12 @@ WebUI::WebUI(Settings *settings, LED *statusLED, SysInfo *sysInfo, UpdateCheck *
     _rawUartUdpListener = rawUartUdpListener;
     _radioModuleConnector = radioModuleConnector;
     _radioModuleDetector = radioModuleDetector;
+    _gps = gps;
+    _dcf = dcf;
+    _clk = clk;
+    _telemetry = telemetry;
+
+    _liveStatus = new LiveStatus(settings, sysInfo, rawUartUdpListener, clk);
 
     char tokenBase[21];
     *((uint32_t *)tokenBase) = esp_random();
@@ -466,9 +981,13 @@ WebUI::WebUI(Settings *settings, LED *statusLED, SysInfo *sysInfo, UpdateCheck *
 
 void WebUI::start()
 {
+    _bundle.mount();
+    _liveStatus->start();
+
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.lru_purge_enable = true;
-    config.max_uri_handlers = 10;
+    config.max_uri_handlers = 12;
+    config.stack_size = 6144; // handlers keep their response buffer on the stack
     config.uri_match_fn = httpd_uri_match_wildcard;
 
     httpd_handle_t _httpd_handle = NULL;
@@ -477,14 +996,16 @@ void WebUI::start()
     {
         httpd_register_uri_handler(_httpd_handle, &post_login_json_handler);
         httpd_register_uri_handler(_httpd_handle, &get_sysinfo_json_handler);
+        httpd_register_uri_handler(_httpd_handle, &get_status_ws_handler);
+        httpd_register_uri_handler(_httpd_handle, &get_profiler_json_handler);
+        httpd_register_uri_handler(_httpd_handle, &get_history_json_handler);
+        httpd_register_uri_handler(_httpd_handle, &get_metrics_handler);
+        httpd_register_uri_handler(_httpd_handle, &get_log_handler);
         httpd_register_uri_handler(_httpd_handle, &get_settings_json_handler);
         httpd_register_uri_handler(_httpd_handle, &post_settings_json_handler);
         httpd_register_uri_handler(_httpd_handle, &post_ota_update_handler);
 
-        httpd_register_uri_handler(_httpd_handle, &main_1e43358e_js_gz_handler);
-        httpd_register_uri_handler(_httpd_handle, &main_1e43358e_css_gz_handler);
-        httpd_register_uri_handler(_httpd_handle, &favicon_26242483_ico_gz_handler);
-        httpd_register_uri_handler(_httpd_handle, &index_html_gz_handler);
+        httpd_register_uri_handler(_httpd_handle, &get_webui_handler);
     }
 }
 
@@ -0,0 +1,255 @@
+/* 
+ *  webuibundle.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include "webuibundle.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "mbedtls/md.h"
+
+static const char *TAG = "WebUIBundle";
+
+#define COPY_CHUNK_SIZE SPI_FLASH_SEC_SIZE
+
+// checks the header, the hash and the file table of a mapped bundle
+static bool validate(const uint8_t *data, size_t size)
+{
+    const webui_bundle_header_t *header = (const webui_bundle_header_t *)data;
+
+    if (header->magic != WEBUI_BUNDLE_MAGIC || header->version != WEBUI_BUNDLE_VERSION || header->totalLength < sizeof(webui_bundle_header_t) + header->fileCount * sizeof(webui_bundle_entry_t) || header->totalLength > size)
+    {
+        ESP_LOGW(TAG, "No web UI installed");
+        return false;
+    }
+
+    unsigned char sha256[32];
+    mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), data + sizeof(webui_bundle_header_t), header->totalLength - sizeof(webui_bundle_header_t), sha256);
+
+    if (memcmp(sha256, header->sha256, sizeof(sha256)) != 0)
+    {
+        ESP_LOGE(TAG, "Web UI is corrupted");
+        return false;
+    }
+
+    const webui_bundle_entry_t *entries = (const webui_bundle_entry_t *)(header + 1);
+    for (int i = 0; i < header->fileCount; i++)
+    {
+        if (entries[i].offset > header->totalLength || entries[i].length > header->totalLength - entries[i].offset)
+        {
+            ESP_LOGE(TAG, "Web UI contains invalid file %.32s", entries[i].path);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+WebUIBundle::WebUIBundle() : _staging(NULL), _mmapHandle(0), _data(NULL), _header(NULL), _updateLength(0), _updateWritten(0), _updateErased(0)
+{
+    _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
+    _etag[0] = 0;
+}
+
+bool WebUIBundle::mount()
+{
+    unmount();
+
+    if (_partition == NULL)
+    {
+        ESP_LOGE(TAG, "No partition for the web UI found");
+        return false;
+    }
+
+    const void *data;
+    if (esp_partition_mmap(_partition, 0, _partition->size, SPI_FLASH_MMAP_DATA, &data, &_mmapHandle) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Could not map partition %s", _partition->label);
+        return false;
+    }
+
+    if (!validate((const uint8_t *)data, _partition->size))
+    {
+        spi_flash_munmap(_mmapHandle);
+        return false;
+    }
+
+    const webui_bundle_header_t *header = (const webui_bundle_header_t *)data;
+
+    _data = (const uint8_t *)data;
+    _header = header;
+
+    // strong ETag built from the bundle hash
+    _etag[0] = '"';
+    for (int i = 0; i < 8; i++)
+    {
+        sprintf(_etag + 1 + 2 * i, "%02x", header->sha256[i]);
+    }
+    strcpy(_etag + 17, "\"");
+
+    ESP_LOGI(TAG, "Web UI with %d files mapped from partition %s", header->fileCount, _partition->label);
+    return true;
+}
+
+void WebUIBundle::unmount()
+{
+    if (_data != NULL)
+    {
+        _data = NULL;
+        _header = NULL;
+        _etag[0] = 0;
+        spi_flash_munmap(_mmapHandle);
+    }
+}
+
+bool WebUIBundle::isMounted()
+{
+    return _header != NULL;
+}
+
+const webui_bundle_entry_t *WebUIBundle::find(const char *path, size_t pathLength)
+{
+    if (_header == NULL)
+        return NULL;
+
+    const webui_bundle_entry_t *entries = (const webui_bundle_entry_t *)(_header + 1);
+    for (int i = 0; i < _header->fileCount; i++)
+    {
+        if (strnlen(entries[i].path, sizeof(entries[i].path)) == pathLength && strncmp(entries[i].path, path, pathLength) == 0)
+            return &entries[i];
+    }
+
+    return NULL;
+}
+
+const char *WebUIBundle::getData(const webui_bundle_entry_t *entry)
+{
+    return (const char *)_data + entry->offset;
+}
+
+const char *WebUIBundle::getETag()
+{
+    return _etag;
+}
+
+esp_err_t WebUIBundle::beginUpdate()
+{
+    if (_partition == NULL)
+        return ESP_ERR_NOT_FOUND;
+
+    // the upload is staged in the unused app partition, the installed web UI stays untouched until it is verified
+    _staging = esp_ota_get_next_update_partition(NULL);
+    if (_staging == NULL || _staging->size < _partition->size)
+        return ESP_ERR_NOT_FOUND;
+
+    if (_staging == esp_ota_get_boot_partition())
+    {
+        ESP_LOGE(TAG, "A firmware update is pending, restart before updating the web UI");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    _updateLength = 0;
+    _updateWritten = 0;
+    _updateErased = 0;
+
+    return ESP_OK;
+}
+
+esp_err_t WebUIBundle::writeUpdate(const char *data, size_t length)
+{
+    if (_updateWritten == 0)
+    {
+        const webui_bundle_header_t *header = (const webui_bundle_header_t *)data;
+        if (length < sizeof(webui_bundle_header_t) || header->magic != WEBUI_BUNDLE_MAGIC || header->totalLength > _partition->size)
+            return ESP_ERR_INVALID_ARG;
+
+        _updateLength = header->totalLength;
+    }
+
+    // ignore everything behind the bundle
+    if (length > _updateLength - _updateWritten)
+        length = _updateLength - _updateWritten;
+
+    if (length == 0)
+        return ESP_OK;
+
+    uint32_t end = _updateWritten + length;
+    if (end > _updateErased)
+    {
+        uint32_t eraseEnd = (end + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
+        esp_err_t err = esp_partition_erase_range(_staging, _updateErased, eraseEnd - _updateErased);
+        if (err != ESP_OK)
+            return err;
+        _updateErased = eraseEnd;
+    }
+
+    esp_err_t err = esp_partition_write(_staging, _updateWritten, data, length);
+    if (err != ESP_OK)
+        return err;
+
+    _updateWritten = end;
+    return ESP_OK;
+}
+
+esp_err_t WebUIBundle::_verifyStaged()
+{
+    const void *data;
+    spi_flash_mmap_handle_t mmapHandle;
+    if (esp_partition_mmap(_staging, 0, _updateErased, SPI_FLASH_MMAP_DATA, &data, &mmapHandle) != ESP_OK)
+        return ESP_ERR_NO_MEM;
+
+    bool valid = validate((const uint8_t *)data, _updateLength);
+    spi_flash_munmap(mmapHandle);
+
+    return valid ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
+
+esp_err_t WebUIBundle::endUpdate()
+{
+    if (_updateLength == 0 || _updateWritten != _updateLength)
+        return ESP_ERR_INVALID_SIZE;
+
+    esp_err_t err = _verifyStaged();
+    if (err != ESP_OK)
+        return err;
+
+    char *buffer = (char *)malloc(COPY_CHUNK_SIZE);
+    if (buffer == NULL)
+        return ESP_ERR_NO_MEM;
+
+    // the mapping must not be used while the flash is rewritten
+    unmount();
+
+    err = esp_partition_erase_range(_partition, 0, _updateErased);
+    for (uint32_t offset = 0; err == ESP_OK && offset < _updateLength; offset += COPY_CHUNK_SIZE)
+    {
+        size_t length = _updateLength - offset < COPY_CHUNK_SIZE ? _updateLength - offset : COPY_CHUNK_SIZE;
+        err = esp_partition_read(_staging, offset, buffer, length);
+        if (err == ESP_OK)
+            err = esp_partition_write(_partition, offset, buffer, length);
+    }
+
+    free(buffer);
+
+    if (err != ESP_OK)
+        return err;
+
+    return mount() ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
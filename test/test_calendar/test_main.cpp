@@ -0,0 +1,148 @@
+/* 
+ *  test_main.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <time.h>
+#include <chrono>
+#include "calendar.h"
+
+static const uint8_t _daysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+// the year and month loop of dcf2epoch before calendar.h, tm_year based
+static int isLeapTm(unsigned int y)
+{
+    return (y % 4) == 0 && ((y % 100) != 0 || ((y + 1900) % 400) == 0);
+}
+
+static long loopDaysFromCivil(int tmYear, int tmMonth, int day)
+{
+    long res = 0;
+    for (int i = 70; i < tmYear; ++i)
+        res += isLeapTm(i) ? 366 : 365;
+    for (int i = 0; i < tmMonth; ++i)
+    {
+        res += _daysInMonth[i];
+        if (i == 1 && isLeapTm(tmYear))
+            res++;
+    }
+    return res + day - 1;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// every day of the DCF77 century, against the old loop, timegm and gmtime
+void test_round_trip_2000_2099()
+{
+    int32_t expected = daysFromCivil(1999, 12, 31);
+
+    for (int year = 2000; year <= 2099; year++)
+    {
+        for (int month = 1; month <= 12; month++)
+        {
+            int days = _daysInMonth[month - 1] + (month == 2 && isLeapYear(year));
+
+            for (int day = 1; day <= days; day++)
+            {
+                int32_t value = daysFromCivil(year, month, day);
+                TEST_ASSERT_EQUAL_INT(++expected, value);
+                TEST_ASSERT_EQUAL_INT(loopDaysFromCivil(year - 1900, month - 1, day), value);
+
+                int y, m, d;
+                civilFromDays(value, &y, &m, &d);
+                TEST_ASSERT_EQUAL_INT(year, y);
+                TEST_ASSERT_EQUAL_INT(month, m);
+                TEST_ASSERT_EQUAL_INT(day, d);
+
+                struct tm tm = {};
+                tm.tm_year = year - 1900;
+                tm.tm_mon = month - 1;
+                tm.tm_mday = day;
+                tm.tm_hour = 23;
+                tm.tm_min = 59;
+                tm.tm_sec = 59;
+                time_t epoch = timegm(&tm);
+                TEST_ASSERT_EQUAL_INT64(epoch, epochFromCivil(year, month, day, 23, 59, 59));
+
+                struct tm check;
+                gmtime_r(&epoch, &check);
+                TEST_ASSERT_EQUAL_UINT(check.tm_wday, weekdayFromDays(value));
+            }
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT(daysFromCivil(2100, 1, 1) - 1, expected);
+}
+
+void test_negative_days()
+{
+    for (int32_t value = -800000; value < 0; value += 7)
+    {
+        int y, m, d;
+        civilFromDays(value, &y, &m, &d);
+        TEST_ASSERT_EQUAL_INT(value, daysFromCivil(y, m, d));
+    }
+
+    TEST_ASSERT_EQUAL_UINT(3, weekdayFromDays(-1)); // 1969-12-31 was a Wednesday
+}
+
+void test_bcd()
+{
+    for (int value = 0; value < 100; value++)
+    {
+        TEST_ASSERT_EQUAL_INT(value, bcd2bin(bin2bcd(value)));
+        TEST_ASSERT_EQUAL_INT((value / 10) << 4 | (value % 10), bin2bcd(value));
+    }
+}
+
+void test_benchmark()
+{
+    const int iterations = 2000000;
+    volatile long sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        sink = sink + loopDaysFromCivil(100 + i % 100, i % 12, 1 + i % 28);
+    auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        sink = sink + daysFromCivil(2000 + i % 100, 1 + i % 12, 1 + i % 28);
+    auto end = std::chrono::steady_clock::now();
+
+    char message[80];
+    snprintf(message, sizeof(message), "loop %.1f ns, calendar.h %.1f ns per date",
+             std::chrono::duration<double, std::nano>(middle - start).count() / iterations,
+             std::chrono::duration<double, std::nano>(end - middle).count() / iterations);
+    TEST_MESSAGE(message);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_2000_2099);
+    RUN_TEST(test_negative_days);
+    RUN_TEST(test_bcd);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
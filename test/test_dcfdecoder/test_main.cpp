@@ -0,0 +1,335 @@
+/* 
+ *  test_main.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "dcfdecoder.h"
+#include "calendar.h"
+
+// all traces are synthetic, generated below from the DCF77 frame format, none of them is recorded from a receiver
+#define TRACE_MINUTES 30
+#define NO_SYNC INT32_MAX
+
+// DCF77 frames of a local (CEST) time, pulse by pulse, with optional noise
+class TraceGenerator
+{
+private:
+    int64_t _start; // local epoch of the first second
+    uint32_t _seed;
+    int _noise;   // per mille of pulses with a random length
+    int _dropped; // per mille of missing pulses
+    int _wrongWeekday;
+    bool _erasedDateParity;
+
+    uint32_t _random()
+    {
+        _seed = _seed * 1103515245 + 12345;
+        return _seed >> 8;
+    }
+
+    void _encode(int *bits, int startBit, int count, int value)
+    {
+        for (int i = 0; i < count; i++)
+            bits[startBit + i] = (value >> i) & 1;
+    }
+
+    static int _parity(int value)
+    {
+        int res = 0;
+        for (; value; value >>= 1)
+            res ^= value & 1;
+        return res;
+    }
+
+public:
+    TraceGenerator(int64_t start, uint32_t seed, int noise, int dropped) : _start(start), _seed(seed), _noise(noise), _dropped(dropped), _wrongWeekday(0), _erasedDateParity(false)
+    {
+    }
+
+    void setWrongWeekday(int offset)
+    {
+        _wrongWeekday = offset;
+    }
+
+    void setErasedDateParity()
+    {
+        _erasedDateParity = true;
+    }
+
+    // the frame sent during a minute announces the following minute
+    void frame(int64_t minuteStart, int *bits)
+    {
+        int64_t announced = minuteStart + 60;
+        int32_t days = (int32_t)(announced / 86400);
+        int seconds = (int)(announced % 86400);
+        int year, month, day;
+        civilFromDays(days, &year, &month, &day);
+        int weekday = (weekdayFromDays(days) + 6 + _wrongWeekday) % 7 + 1;
+
+        memset(bits, 0, sizeof(int) * 60);
+        bits[17] = 1; // CEST
+        bits[20] = 1;
+
+        int minute = bin2bcd(seconds / 60 % 60);
+        int hour = bin2bcd(seconds / 3600);
+        _encode(bits, 21, 7, minute);
+        bits[28] = _parity(minute);
+        _encode(bits, 29, 6, hour);
+        bits[35] = _parity(hour);
+
+        int date[] = {bin2bcd(day), bin2bcd(weekday), bin2bcd(month), bin2bcd(year - 2000)};
+        _encode(bits, 36, 6, date[0]);
+        _encode(bits, 42, 3, date[1]);
+        _encode(bits, 45, 5, date[2]);
+        _encode(bits, 50, 8, date[3]);
+        bits[58] = _parity(date[0]) ^ _parity(date[1]) ^ _parity(date[2]) ^ _parity(date[3]);
+    }
+
+    // pulse at second t of the trace, false if there is none
+    bool pulse(int t, int64_t *secondMark, int64_t *pulseLength, int64_t *epoch)
+    {
+        *epoch = _start + t;
+        int second = (int)(*epoch % 60);
+        if (second == 59)
+            return false;
+
+        int bits[60];
+        frame(*epoch - second, bits);
+
+        *secondMark = 1000000LL + t * 1000000LL + (int64_t)(_random() % 4000) - 2000;
+        *pulseLength = bits[second] ? 200000 : 100000;
+        *pulseLength += (int64_t)(_random() % 20000) - 10000;
+
+        if (second == 58 && _erasedDateParity)
+            *pulseLength = 150000;
+        if ((int)(_random() % 1000) < _noise)
+            *pulseLength = 40000 + _random() % 260000;
+
+        return (int)(_random() % 1000) >= _dropped;
+    }
+};
+
+// the hard-decision decoder which was used before DcfDecoder, kept as reference for the sync time
+class ReferenceDecoder
+{
+private:
+    uint64_t _buffer = 0;
+    uint8_t _bufferPos = 0;
+    int64_t _previousSecondMark = 0;
+
+    bool _checkParity(uint8_t start, uint8_t end)
+    {
+        int parity = 0;
+        for (int pos = start; pos <= end; pos++)
+            parity ^= (int)((_buffer >> pos) & 1);
+        return parity == 0;
+    }
+
+public:
+    bool addPulse(int64_t secondMark, int64_t pulseLength, int64_t *epoch)
+    {
+        int64_t secondLength = secondMark - _previousSecondMark;
+        _previousSecondMark = secondMark;
+
+        uint64_t pulseValue;
+        if (pulseLength > 80000 && pulseLength < 135000)
+            pulseValue = 0;
+        else if (pulseLength > 180000 && pulseLength < 235000)
+            pulseValue = 1;
+        else
+            return false;
+
+        if (secondLength > 970000 && secondLength < 1035000)
+        {
+            if (_bufferPos < 59)
+            {
+                _bufferPos++;
+                _buffer |= (pulseValue << _bufferPos);
+            }
+            return false;
+        }
+
+        if (secondLength <= 1970000 || secondLength >= 2035000)
+            return false;
+
+        uint8_t timezone = (uint8_t)((_buffer >> 17) & 3);
+        bool valid = _bufferPos >= 58 && _bufferPos <= 59 && (_buffer & 1) == 0 && ((_buffer >> 20) & 1) == 1 && timezone != 0 && timezone != 3 && _checkParity(21, 28) && _checkParity(29, 35) && _checkParity(36, 58);
+
+        if (valid)
+        {
+            *epoch = epochFromCivil(2000 + bcd2bin((_buffer >> 50) & 0xff), bcd2bin((_buffer >> 45) & 0x1f), bcd2bin((_buffer >> 36) & 0x3f), bcd2bin((_buffer >> 29) & 0x3f), bcd2bin((_buffer >> 21) & 0x7f), 0);
+        }
+
+        _buffer = pulseValue;
+        _bufferPos = 0;
+        return valid;
+    }
+};
+
+typedef struct
+{
+    int decoderSync;   // second of the trace, NO_SYNC if never
+    int referenceSync; // second of the trace, NO_SYNC if never
+    int decoderWrong;
+    int referenceWrong;
+    int decoderSyncs;
+} trace_result_t;
+
+static trace_result_t runTrace(TraceGenerator *generator)
+{
+    trace_result_t res = {NO_SYNC, NO_SYNC, 0, 0, 0};
+    DcfDecoder decoder;
+    ReferenceDecoder reference;
+
+    for (int t = 0; t < TRACE_MINUTES * 60; t++)
+    {
+        int64_t secondMark, pulseLength, epoch;
+        if (!generator->pulse(t, &secondMark, &pulseLength, &epoch))
+            continue;
+
+        dcf_time_t time;
+        if (decoder.addPulse(secondMark, pulseLength, &time))
+        {
+            res.decoderSyncs++;
+            if (epochFromCivil(time.year, time.month, time.day, time.hour, time.minute, time.second) != epoch || time.timezone != 1)
+                res.decoderWrong++;
+            else if (res.decoderSync == NO_SYNC)
+                res.decoderSync = t;
+        }
+
+        int64_t referenceEpoch;
+        if (reference.addPulse(secondMark, pulseLength, &referenceEpoch))
+        {
+            if (referenceEpoch != epoch)
+                res.referenceWrong++;
+            else if (res.referenceSync == NO_SYNC)
+                res.referenceSync = t;
+        }
+    }
+
+    return res;
+}
+
+static const int64_t _traceStart = epochFromCivil(2026, 10, 19, 13, 10, 27);
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_clean_signal()
+{
+    TraceGenerator generator(_traceStart, 1, 0, 0);
+    trace_result_t res = runTrace(&generator);
+
+    TEST_ASSERT_EQUAL_INT(0, res.decoderWrong);
+    TEST_ASSERT_EQUAL_INT(0, res.referenceWrong);
+    TEST_ASSERT_TRUE(res.decoderSync != NO_SYNC && res.referenceSync != NO_SYNC);
+    // a clean frame is accepted on its own, so the first complete frame after the minute mark sets the clock
+    TEST_ASSERT_LESS_OR_EQUAL(res.referenceSync, res.decoderSync);
+
+    char message[80];
+    snprintf(message, sizeof(message), "clean signal: first sync after %d s, reference %d s", res.decoderSync, res.referenceSync);
+    TEST_MESSAGE(message);
+}
+
+// time to first sync against the reference decoder over many noisy traces
+void test_noisy_signal()
+{
+    static const int noiseLevels[] = {20, 50, 100, 200, 300};
+
+    for (int level = 0; level < (int)(sizeof(noiseLevels) / sizeof(noiseLevels[0])); level++)
+    {
+        int noise = noiseLevels[level];
+        int synced = 0, referenceSynced = 0, wrong = 0, referenceWrong = 0;
+        long total = 0, referenceTotal = 0;
+        const int runs = 50;
+
+        for (int run = 0; run < runs; run++)
+        {
+            TraceGenerator generator(_traceStart + run * 7919, 1000 * noise + run, noise, noise / 4);
+            trace_result_t res = runTrace(&generator);
+
+            wrong += res.decoderWrong;
+            referenceWrong += res.referenceWrong;
+            if (res.decoderSync != NO_SYNC)
+            {
+                synced++;
+                total += res.decoderSync;
+            }
+            if (res.referenceSync != NO_SYNC)
+            {
+                referenceSynced++;
+                referenceTotal += res.referenceSync;
+            }
+        }
+
+        char message[160];
+        snprintf(message, sizeof(message), "%2d%% noise: synced %d/%d after %ld s (%d wrong), reference %d/%d after %ld s (%d wrong)",
+                 noise / 10, synced, runs, synced ? total / synced : 0, wrong, referenceSynced, runs, referenceSynced ? referenceTotal / referenceSynced : 0, referenceWrong);
+        TEST_MESSAGE(message);
+
+        TEST_ASSERT_EQUAL_INT(0, wrong);
+        TEST_ASSERT_TRUE(synced >= referenceSynced);
+    }
+}
+
+void test_rollover()
+{
+    // midnight of new year's eve, the date fields change during the trace
+    TraceGenerator generator(epochFromCivil(2029, 12, 31, 23, 50, 0), 7, 50, 10);
+    trace_result_t res = runTrace(&generator);
+
+    TEST_ASSERT_EQUAL_INT(0, res.decoderWrong);
+    TEST_ASSERT_TRUE(res.decoderSync != NO_SYNC);
+}
+
+void test_reject_wrong_weekday()
+{
+    // date parity still matches, but the weekday does not belong to the date
+    TraceGenerator generator(_traceStart, 3, 0, 0);
+    generator.setWrongWeekday(1);
+    trace_result_t res = runTrace(&generator);
+
+    TEST_ASSERT_EQUAL_INT(0, res.decoderSyncs);
+}
+
+void test_reject_unknown_date_parity()
+{
+    TraceGenerator generator(_traceStart, 5, 0, 0);
+    generator.setErasedDateParity();
+    trace_result_t res = runTrace(&generator);
+
+    TEST_ASSERT_EQUAL_INT(0, res.decoderSyncs);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_clean_signal);
+    RUN_TEST(test_noisy_signal);
+    RUN_TEST(test_rollover);
+    RUN_TEST(test_reject_wrong_weekday);
+    RUN_TEST(test_reject_unknown_date_parity);
+    return UNITY_END();
+}
@@ -0,0 +1,258 @@
+/* 
+ *  test_main.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "nmea.h"
+
+// seeds of the fuzz test, every sentence type and talker the GPS module has to cope with
+static const char *_corpus[] = {
+    "$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A",
+    "$GNRMC,201530.00,A,5230.12345,N,01323.54321,E,0.012,,040702,,,A*6B",
+    "$GPRMC,235959.999,V,,,,,,,311299,,,N*7C",
+    "$GNZDA,201530.00,04,07,2002,00,00*7E",
+    "$GPZDA,000000,01,01,2000,,*42",
+    "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47",
+    "$GNGGA,201530.00,,,,,0,00,99.99,,,,,,*7A",
+    "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74",
+    "$PUBX,04,073731.00,091202,113851.00,1196,15D,1930035,-2660.664,43*71",
+    "$GPTXT,01,01,02,u-blox ag - www.u-blox.com*50",
+    "$,*00",
+    "$*00",
+};
+
+static void setChecksum(unsigned char *buffer, uint16_t len)
+{
+    // buffer ends with "*hh"
+    uint8_t checksum = 0;
+    for (uint16_t i = 1; i < len - 3; i++)
+        checksum ^= buffer[i];
+
+    static const char hex[] = "0123456789ABCDEF";
+    buffer[len - 2] = hex[checksum >> 4];
+    buffer[len - 1] = hex[checksum & 15];
+}
+
+static uint16_t copySentence(const char *sentence, unsigned char *buffer)
+{
+    uint16_t len = strlen(sentence);
+    memcpy(buffer, sentence, len);
+    return len;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_parse_rmc()
+{
+    unsigned char buffer[128];
+    uint16_t len = copySentence(_corpus[0], buffer);
+
+    NmeaSentence sentence;
+    TEST_ASSERT_TRUE(NmeaSentence::hasType(buffer, len, "RMC"));
+    TEST_ASSERT_TRUE(sentence.parse(buffer, len));
+    TEST_ASSERT_TRUE(sentence.isType("RMC"));
+    TEST_ASSERT_EQUAL(12, sentence.getFieldCount());
+    TEST_ASSERT_EQUAL_CHAR('A', sentence.getChar(2));
+
+    int hour, minute, second, usec;
+    TEST_ASSERT_TRUE(sentence.getTime(1, &hour, &minute, &second, &usec));
+    TEST_ASSERT_EQUAL(12, hour);
+    TEST_ASSERT_EQUAL(35, minute);
+    TEST_ASSERT_EQUAL(19, second);
+    TEST_ASSERT_EQUAL(0, usec);
+
+    int day, month, year;
+    TEST_ASSERT_TRUE(sentence.getDate(9, &day, &month, &year));
+    TEST_ASSERT_EQUAL(23, day);
+    TEST_ASSERT_EQUAL(3, month);
+    TEST_ASSERT_EQUAL(2094, year);
+}
+
+void test_parse_line_terminators()
+{
+    unsigned char buffer[128];
+    uint16_t len = copySentence(_corpus[3], buffer);
+    memcpy(buffer + len, "\r\n", 3);
+
+    NmeaSentence sentence;
+    TEST_ASSERT_TRUE(sentence.parse(buffer, len + 3));
+    TEST_ASSERT_TRUE(sentence.isType("ZDA"));
+
+    int hour, minute, second, usec;
+    TEST_ASSERT_TRUE(sentence.getTime(1, &hour, &minute, &second, &usec));
+    TEST_ASSERT_EQUAL(20, hour);
+    TEST_ASSERT_EQUAL(0, usec);
+
+    int year;
+    TEST_ASSERT_TRUE(sentence.getInt(4, &year));
+    TEST_ASSERT_EQUAL(2002, year);
+}
+
+void test_reject_checksum()
+{
+    unsigned char buffer[128];
+    uint16_t len = copySentence(_corpus[0], buffer);
+    buffer[len - 1] = 'B';
+
+    NmeaSentence sentence;
+    TEST_ASSERT_FALSE(sentence.parse(buffer, len));
+    TEST_ASSERT_EQUAL(0, sentence.getFieldCount());
+}
+
+void test_talker_id()
+{
+    unsigned char buffer[128];
+    uint16_t len = copySentence(_corpus[1], buffer);
+    TEST_ASSERT_TRUE(NmeaSentence::hasType(buffer, len, "RMC"));
+
+    // proprietary sentences never match a standard type
+    len = copySentence(_corpus[8], buffer);
+    NmeaSentence sentence;
+    TEST_ASSERT_TRUE(sentence.parse(buffer, len));
+    TEST_ASSERT_FALSE(sentence.isType("UBX"));
+    TEST_ASSERT_FALSE(NmeaSentence::hasType(buffer, len, "UBX"));
+}
+
+void test_fuzz_corpus()
+{
+    static const unsigned char interesting[] = {',', '*', '$', '.', '\r', '\n', 0, '0', '9', 'A', 'f', 0xff};
+
+    uint32_t seed = 0x4e4d4541;
+    int accepted = 0;
+
+    for (int run = 0; run < 200000; run++)
+    {
+        unsigned char buffer[140];
+        uint16_t len = copySentence(_corpus[run % (sizeof(_corpus) / sizeof(_corpus[0]))], buffer);
+
+        int mutations = 1 + run % 4;
+        for (int i = 0; i < mutations && len > 0; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            uint16_t pos = (seed >> 8) % len;
+
+            switch ((seed >> 24) % 4)
+            {
+            case 0:
+                buffer[pos] = interesting[(seed >> 4) % sizeof(interesting)];
+                break;
+            case 1:
+                buffer[pos] = seed >> 16;
+                break;
+            case 2:
+                memmove(buffer + pos, buffer + pos + 1, len - pos - 1);
+                len--;
+                break;
+            default:
+                if (len < sizeof(buffer))
+                {
+                    memmove(buffer + pos + 1, buffer + pos, len - pos);
+                    len++;
+                }
+                break;
+            }
+        }
+
+        // repair the checksum of every other sample, so the field accessors see the damaged fields too
+        if (run % 2 && len > 3 && buffer[len - 3] == '*')
+            setChecksum(buffer, len);
+
+        NmeaSentence sentence;
+        if (!sentence.parse(buffer, len))
+        {
+            TEST_ASSERT_EQUAL(0, sentence.getFieldCount());
+            continue;
+        }
+
+        accepted++;
+        TEST_ASSERT_TRUE(sentence.getFieldCount() > 0 && sentence.getFieldCount() <= NMEA_MAX_FIELDS);
+
+        for (uint8_t i = 0; i <= sentence.getFieldCount(); i++)
+        {
+            nmea_field_t field = sentence.getField(i);
+            if (i == sentence.getFieldCount())
+            {
+                TEST_ASSERT_TRUE(field.data == NULL && field.len == 0);
+                continue;
+            }
+
+            TEST_ASSERT_TRUE(field.data > buffer && field.data + field.len <= buffer + len);
+
+            int a, b, c, d;
+            sentence.getChar(i);
+            sentence.getInt(i, &a);
+            if (sentence.getTime(i, &a, &b, &c, &d))
+                TEST_ASSERT_TRUE(a <= 23 && b <= 59 && c <= 60 && d >= 0 && d <= 999999);
+            if (sentence.getDate(i, &a, &b, &c))
+                TEST_ASSERT_TRUE(a >= 1 && a <= 31 && b >= 1 && b <= 12 && c >= 2000 && c <= 2099);
+        }
+    }
+
+    TEST_ASSERT_GREATER_THAN(0, accepted);
+}
+
+void test_benchmark()
+{
+    unsigned char buffers[3][128];
+    uint16_t lens[3];
+    lens[0] = copySentence(_corpus[1], buffers[0]);
+    lens[1] = copySentence(_corpus[3], buffers[1]);
+    lens[2] = copySentence(_corpus[7], buffers[2]);
+
+    const int iterations = 1000000;
+    int fields = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        NmeaSentence sentence;
+        int hour, minute, second, usec;
+        if (NmeaSentence::hasType(buffers[i % 3], lens[i % 3], "GSV"))
+            continue;
+        if (sentence.parse(buffers[i % 3], lens[i % 3]) && sentence.getTime(1, &hour, &minute, &second, &usec))
+            fields += sentence.getFieldCount();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    TEST_ASSERT_GREATER_THAN(0, fields);
+
+    char message[64];
+    snprintf(message, sizeof(message), "%lld ns per sentence", (long long)(elapsed / iterations));
+    TEST_MESSAGE(message);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_rmc);
+    RUN_TEST(test_parse_line_terminators);
+    RUN_TEST(test_reject_checksum);
+    RUN_TEST(test_talker_id);
+    RUN_TEST(test_fuzz_corpus);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
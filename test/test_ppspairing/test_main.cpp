@@ -0,0 +1,164 @@
+/* 
+ *  test_main.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include "ppspairing.h"
+
+// synthetic edge streams, the timestamps are made up and not recorded from a receiver
+#define SECOND 1000000LL
+#define SENTENCE_DELAY 80000LL // usec between the pulse and the end of the RMC sentence
+
+static PpsPairing _pairing;
+
+void setUp()
+{
+    _pairing.reset();
+}
+
+void tearDown()
+{
+}
+
+static void addEdges(int first, int last)
+{
+    for (int second = first; second <= last; second++)
+        _pairing.addEdge(second * SECOND);
+}
+
+void test_pair_preceding_edge()
+{
+    int64_t edge;
+
+    _pairing.addEdge(1 * SECOND);
+    TEST_ASSERT_FALSE(_pairing.isLocked());
+    TEST_ASSERT_FALSE(_pairing.pair(1 * SECOND + SENTENCE_DELAY, &edge));
+
+    addEdges(2, 3);
+    TEST_ASSERT_TRUE(_pairing.isLocked());
+    TEST_ASSERT_TRUE(_pairing.pair(3 * SECOND + SENTENCE_DELAY, &edge));
+    TEST_ASSERT_EQUAL_INT64(3 * SECOND, edge);
+
+    // a sentence can not start before its pulse
+    TEST_ASSERT_FALSE(_pairing.pair(3 * SECOND - 1, &edge));
+}
+
+void test_missing_edge()
+{
+    int64_t edge;
+
+    addEdges(1, 3);
+
+    // the pulse of second 4 is lost, its sentence must not be labeled with the edge of second 3
+    TEST_ASSERT_FALSE(_pairing.pair(4 * SECOND + SENTENCE_DELAY, &edge));
+
+    // the gap breaks the lock until the next regular interval
+    _pairing.addEdge(5 * SECOND);
+    TEST_ASSERT_FALSE(_pairing.isLocked());
+    TEST_ASSERT_FALSE(_pairing.pair(5 * SECOND + SENTENCE_DELAY, &edge));
+
+    _pairing.addEdge(6 * SECOND);
+    TEST_ASSERT_TRUE(_pairing.pair(6 * SECOND + SENTENCE_DELAY, &edge));
+    TEST_ASSERT_EQUAL_INT64(6 * SECOND, edge);
+}
+
+void test_double_and_glitch_edge()
+{
+    int64_t edge;
+
+    addEdges(1, 2);
+
+    // contact bounce right after the real edge and a spike in the middle of the second
+    _pairing.addEdge(2 * SECOND + 20);
+    _pairing.addEdge(2 * SECOND + SECOND / 3);
+    TEST_ASSERT_TRUE(_pairing.isLocked());
+    TEST_ASSERT_TRUE(_pairing.pair(2 * SECOND + SENTENCE_DELAY, &edge));
+    TEST_ASSERT_EQUAL_INT64(2 * SECOND, edge);
+
+    // the following real edge is still measured against the last valid one
+    _pairing.addEdge(3 * SECOND);
+    TEST_ASSERT_TRUE(_pairing.pair(3 * SECOND + SENTENCE_DELAY, &edge));
+    TEST_ASSERT_EQUAL_INT64(3 * SECOND, edge);
+}
+
+void test_outlier_rejection()
+{
+    int64_t edge;
+
+    addEdges(1, 3);
+
+    // 2 ms off is far beyond the tolerance of a GPS receiver
+    _pairing.addEdge(4 * SECOND + 2000);
+    TEST_ASSERT_FALSE(_pairing.isLocked());
+    TEST_ASSERT_FALSE(_pairing.pair(4 * SECOND + SENTENCE_DELAY, &edge));
+
+    // the stream is trusted again after one regular interval
+    _pairing.addEdge(5 * SECOND + 2000);
+    TEST_ASSERT_TRUE(_pairing.pair(5 * SECOND + SENTENCE_DELAY, &edge));
+    TEST_ASSERT_EQUAL_INT64(5 * SECOND + 2000, edge);
+}
+
+void test_jitter_within_tolerance()
+{
+    int64_t edge;
+    srand(1);
+
+    for (int second = 1; second <= 3600; second++)
+    {
+        int64_t edgeTime = second * SECOND + (rand() % 401) - 200;
+        _pairing.addEdge(edgeTime);
+
+        if (second > 1)
+        {
+            TEST_ASSERT_TRUE(_pairing.pair(edgeTime + SENTENCE_DELAY, &edge));
+            TEST_ASSERT_EQUAL_INT64(edgeTime, edge);
+        }
+    }
+}
+
+void test_late_edge()
+{
+    int64_t edge;
+
+    addEdges(1, 3);
+
+    // the edge of second 4 is delivered after its sentence, the sentence stays unpaired
+    TEST_ASSERT_FALSE(_pairing.pair(4 * SECOND + SENTENCE_DELAY, &edge));
+    _pairing.addEdge(4 * SECOND);
+    TEST_ASSERT_TRUE(_pairing.isLocked());
+
+    // a sentence arriving late in the second is still paired with its edge
+    TEST_ASSERT_TRUE(_pairing.pair(4 * SECOND + SECOND / 2, &edge));
+    TEST_ASSERT_EQUAL_INT64(4 * SECOND, edge);
+
+    // too close to the next pulse to be trusted
+    TEST_ASSERT_FALSE(_pairing.pair(5 * SECOND - 200, &edge));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_pair_preceding_edge);
+    RUN_TEST(test_missing_edge);
+    RUN_TEST(test_double_and_glitch_edge);
+    RUN_TEST(test_outlier_rejection);
+    RUN_TEST(test_jitter_within_tolerance);
+    RUN_TEST(test_late_edge);
+    return UNITY_END();
+}
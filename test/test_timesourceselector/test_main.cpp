@@ -0,0 +1,205 @@
+/* 
+ *  test_main.cpp is part of the HB-RF-ETH firmware - https://github.com/alexreinert/HB-RF-ETH
+ *  
+ *  Copyright 2022 Alexander Reinert
+ *  
+ *  The HB-RF-ETH firmware is licensed under a
+ *  Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+ *  
+ *  You should have received a copy of the license along with this
+ *  work.  If not, see <http://creativecommons.org/licenses/by-nc-sa/4.0/>.
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *  
+ */
+
+#include <unity.h>
+#include <stdlib.h>
+#include "timesourceselector.h"
+
+// synthetic sample traces, the offsets are made up and not recorded from real sources
+#define SECOND 1000000LL
+#define MINUTE (60 * SECOND)
+
+static TimeSourceSelector *_selector;
+
+void setUp()
+{
+    _selector = new TimeSourceSelector();
+}
+
+void tearDown()
+{
+    delete _selector;
+}
+
+void test_first_sync()
+{
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_NONE, _selector->getSelected());
+    TEST_ASSERT_FALSE(_selector->addSample(CLOCK_SOURCE_RTC, 0, 0));
+    TEST_ASSERT_FALSE(_selector->addSample(CLOCK_SOURCE_NONE, 0, 0));
+
+    TEST_ASSERT_TRUE(_selector->addSample(CLOCK_SOURCE_NTP, 1000, 1 * SECOND));
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_NTP, _selector->getSelected());
+}
+
+void test_failover_on_stale_source()
+{
+    int64_t now = 0;
+
+    // PPS every minute, GPS every 5 minutes
+    for (int i = 0; i < 10; i++)
+    {
+        now += MINUTE;
+        _selector->addSample(CLOCK_SOURCE_PPS, 0, now);
+        if (i % 5 == 0)
+            TEST_ASSERT_FALSE(_selector->addSample(CLOCK_SOURCE_GPS, 0, now));
+    }
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_PPS, _selector->getSelected());
+
+    // PPS signal lost, GPS samples are ignored until PPS times out
+    int64_t lastPps = now;
+    while (now + MINUTE < lastPps + 5 * MINUTE)
+    {
+        now += MINUTE;
+        TEST_ASSERT_FALSE(_selector->addSample(CLOCK_SOURCE_GPS, 0, now));
+    }
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_PPS, _selector->getSelected());
+
+    now = lastPps + 5 * MINUTE;
+    TEST_ASSERT_FALSE(_selector->isAvailable(CLOCK_SOURCE_PPS, now));
+    TEST_ASSERT_TRUE(_selector->addSample(CLOCK_SOURCE_GPS, 0, now));
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_GPS, _selector->getSelected());
+}
+
+void test_holdover_without_alternative()
+{
+    _selector->addSample(CLOCK_SOURCE_DCF, 0, MINUTE);
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_DCF, _selector->getSelected());
+
+    // the stale source stays selected as long as nothing else is available
+    TEST_ASSERT_FALSE(_selector->isAvailable(CLOCK_SOURCE_DCF, 60 * MINUTE));
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_DCF, _selector->getSelected());
+}
+
+void test_no_flapping_between_similar_sources()
+{
+    int64_t now = 0;
+    int switches = 0;
+    clock_source_t selected = CLOCK_SOURCE_NONE;
+    srand(1);
+
+    // NTP and GPS have the same base error, they alternate in being the fresher one
+    for (int i = 0; i < 24 * 12; i++)
+    {
+        now += 5 * MINUTE;
+        clock_source_t source = (i % 2 == 0) ? CLOCK_SOURCE_GPS : CLOCK_SOURCE_NTP;
+        _selector->addSample(source, (rand() % 20001) - 10000, now);
+
+        if (_selector->getSelected() != selected)
+        {
+            selected = _selector->getSelected();
+            switches++;
+        }
+    }
+
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_GPS, selected);
+    TEST_ASSERT_EQUAL(1, switches);
+}
+
+void test_switch_to_significantly_better_source()
+{
+    int64_t now = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        now += MINUTE;
+        _selector->addSample(CLOCK_SOURCE_NTP, 0, now);
+    }
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_NTP, _selector->getSelected());
+
+    // a single sample has no jitter estimate yet
+    now += SECOND;
+    TEST_ASSERT_FALSE(_selector->addSample(CLOCK_SOURCE_PPS, 0, now));
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_NTP, _selector->getSelected());
+
+    now += MINUTE;
+    TEST_ASSERT_TRUE(_selector->addSample(CLOCK_SOURCE_PPS, 0, now));
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_PPS, _selector->getSelected());
+}
+
+void test_rebase_after_step()
+{
+    int64_t now = MINUTE;
+
+    TEST_ASSERT_TRUE(_selector->addSample(CLOCK_SOURCE_NTP, 0, now));
+
+    // GPS runs 5 ms ahead of the system clock
+    now += MINUTE;
+    TEST_ASSERT_FALSE(_selector->addSample(CLOCK_SOURCE_GPS, 5000, now));
+
+    // the system clock is stepped by 1 ms, so GPS is only 4 ms ahead afterwards
+    now += SECOND;
+    TEST_ASSERT_TRUE(_selector->addSample(CLOCK_SOURCE_NTP, 1000, now));
+
+    now += MINUTE;
+    TEST_ASSERT_FALSE(_selector->addSample(CLOCK_SOURCE_GPS, 4000, now));
+    TEST_ASSERT_EQUAL(0, _selector->getJitter(CLOCK_SOURCE_GPS));
+
+    // the selected source is rebased too, no offset after the step lets its jitter decay
+    uint32_t jitter = _selector->getJitter(CLOCK_SOURCE_NTP);
+    now += SECOND;
+    TEST_ASSERT_TRUE(_selector->addSample(CLOCK_SOURCE_NTP, 0, now));
+    TEST_ASSERT_GREATER_THAN(_selector->getJitter(CLOCK_SOURCE_NTP), jitter);
+}
+
+void test_recovery_of_preferred_source()
+{
+    int64_t now = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        now += MINUTE;
+        _selector->addSample(CLOCK_SOURCE_PPS, 0, now);
+        _selector->addSample(CLOCK_SOURCE_GPS, 0, now);
+    }
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_PPS, _selector->getSelected());
+
+    // PPS outage of 10 minutes, GPS takes over
+    for (int i = 0; i < 10; i++)
+    {
+        now += MINUTE;
+        _selector->addSample(CLOCK_SOURCE_GPS, 0, now);
+    }
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_GPS, _selector->getSelected());
+
+    // PPS comes back, it has to prove its jitter again before it is preferred
+    now += SECOND;
+    TEST_ASSERT_FALSE(_selector->addSample(CLOCK_SOURCE_PPS, 0, now));
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_GPS, _selector->getSelected());
+
+    now += MINUTE;
+    TEST_ASSERT_TRUE(_selector->addSample(CLOCK_SOURCE_PPS, 0, now));
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_PPS, _selector->getSelected());
+
+    now += MINUTE;
+    TEST_ASSERT_FALSE(_selector->addSample(CLOCK_SOURCE_GPS, 0, now));
+    TEST_ASSERT_EQUAL(CLOCK_SOURCE_PPS, _selector->getSelected());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_sync);
+    RUN_TEST(test_failover_on_stale_source);
+    RUN_TEST(test_holdover_without_alternative);
+    RUN_TEST(test_no_flapping_between_similar_sources);
+    RUN_TEST(test_switch_to_significantly_better_source);
+    RUN_TEST(test_rebase_after_step);
+    RUN_TEST(test_recovery_of_preferred_source);
+    return UNITY_END();
+}
@@ -7,6 +7,7 @@ import VueRouter from 'vue-router'
 Vue.use(VueRouter)
 
 import Axios from 'axios'
+import sha256 from './sha256.js'
 
 import 'bootstrap/dist/css/bootstrap.css'
 import 'bootstrap-vue/dist/bootstrap-vue.css'
@@ -75,7 +76,11 @@ const moduleSysInfo = {
     radioModuleSerial: "",
     radioModuleBidCosRadioMAC: "",
     radioModuleHmIPRadioMAC: "",
-    radioModuleSGTIN: ""
+    radioModuleSGTIN: "",
+    rawUartFramesToRemote: 0.0,
+    rawUartFramesFromRemote: 0.0,
+    clockSource: 0,
+    lastSyncTime: 0
   }),
   mutations: {
     sysInfo(state, newState) {
@@ -91,6 +96,12 @@ const moduleSysInfo = {
       state.radioModuleHmIPRadioMAC = newState.radioModuleHmIPRadioMAC;
       state.radioModuleSGTIN = newState.radioModuleSGTIN;
     },
+    liveStatus(state, delta) {
+      // pushed messages only contain the changed fields
+      Object.keys(delta).forEach(key => {
+        if (key in state) state[key] = delta[key];
+      });
+    },
   },
   actions: {
     update(context) {
@@ -121,11 +132,16 @@ const moduleSettings = {
     gateway: "",
     dns1: "",
     dns2: "",
-    timesource: 0,
+    timesources: 1,
     dcfOffset: 0,
+    dcfCalibration: true,
     gpsBaudrate: 9600,
+    gpsPpsPin: -1,
     ntpServer: "",
     ledBrightness: 100,
+    syslogServer: "",
+    syslogLevel: 0,
+    liveStatusInterval: 1000,
   }),
   mutations: {
     settings(state, value) {
@@ -136,11 +152,16 @@ const moduleSettings = {
       state.gateway = value.gateway;
       state.dns1 = value.dns1;
       state.dns2 = value.dns2;
-      state.timesource = value.timesource;
+      state.timesources = value.timesources;
       state.dcfOffset = value.dcfOffset;
+      state.dcfCalibration = value.dcfCalibration;
       state.gpsBaudrate = value.gpsBaudrate;
+      state.gpsPpsPin = value.gpsPpsPin;
       state.ntpServer = value.ntpServer;
       state.ledBrightness = value.ledBrightness;
+      state.syslogServer = value.syslogServer;
+      state.syslogLevel = value.syslogLevel;
+      state.liveStatusInterval = value.liveStatusInterval;
     },
   },
   actions: {
@@ -186,20 +207,25 @@ const moduleFirmwareUpdate = {
       return new Promise((resolve, reject) => {
         context.commit("progress", 0);
 
-        var form = new FormData();
-        form.append("file", file, file.name);
-        form.append("upload_file", true);
+        // the device verifies the SHA-256, crypto.subtle is only available in secure contexts
+        file.arrayBuffer()
+          .then(data => (window.crypto && window.crypto.subtle)
+            ? window.crypto.subtle.digest("SHA-256", data)
+            : sha256(data))
+          .then(hash => {
+            var headers = {
+              'Content-Type': 'application/octet-stream',
+              'X-SHA256': Array.from(new Uint8Array(hash)).map(b => b.toString(16).padStart(2, "0")).join("")
+            };
 
-        Axios
-          .post("/ota_update", form, {
-            headers: {
-              'Content-Type': 'multipart/form-data'
-            },
-            onUploadProgress: event => {
-              if (event.lengthComputable) {
-                context.commit("progress", Math.ceil((event.loaded || event.position) / event.total * 100));
+            return Axios.post("/ota_update", file, {
+              headers: headers,
+              onUploadProgress: event => {
+                if (event.lengthComputable) {
+                  context.commit("progress", Math.ceil((event.loaded || event.position) / event.total * 100));
+                }
               }
-            }
+            });
           })
           .then(
             response => {